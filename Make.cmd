@@ -1,5 +1,7 @@
 windres ogg-winmm.rc.in -O coff -o ogg-winmm.rc.o
-gcc -std=gnu99 -Wl,--enable-stdcall-fixup -Ilibs/include -O2 -shared -s -o ogg-winmm.dll ogg-winmm.c player.c stubs.c ogg-winmm.def ogg-winmm.rc.o -L. -l:libvorbisfile.a -l:libvorbis.a -l:libogg.a -lwinmm -static
+gcc -std=gnu99 -O2 -s -o genrelay.exe tools/genrelay.c
+genrelay.exe ogg-winmm.def relay.s ogg-winmm.c timer.c sound.c mixer.c midi.c
+gcc -std=gnu99 -Wl,--enable-stdcall-fixup -Ilibs/include -O2 -shared -s -o ogg-winmm.dll ogg-winmm.c player.c reader.c decoder.c resample.c timer.c sound.c mixer.c midi.c stubs.c relay.s trace.c ogg-winmm.def ogg-winmm.rc.o -L. -l:libvorbisfile.a -l:libvorbis.a -l:libogg.a -lwinmm -static
 del winmm.dll
 ren ogg-winmm.dll winmm.dll
 pause
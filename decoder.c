@@ -0,0 +1,339 @@
+/* Track decoders: Ogg Vorbis through vorbisfile (or the integer only Tremor
+   when built with -DTREMOR) and FLAC (native or Ogg encapsulated) through
+   dr_flac. decoder_open() picks one by the magic bytes at the start of the
+   file. */
+
+#ifdef TREMOR
+#include <tremor/ivorbisfile.h>
+#else
+#include <vorbis/vorbisfile.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <windows.h>
+
+#define DR_FLAC_IMPLEMENTATION
+#define DR_FLAC_NO_STDIO
+#define DR_FLAC_NO_WCHAR
+#include "dr_flac.h"
+
+#include "decoder.h"
+#include "pak.h"
+
+/* plain files */
+
+static size_t file_read(void *ptr, size_t size, size_t nmemb, void *datasource)
+{
+    return fread(ptr, size, nmemb, datasource);
+}
+
+static int file_seek(void *datasource, ogg_int64_t offset, int whence)
+{
+    return _fseeki64(datasource, offset, whence);
+}
+
+static int file_close(void *datasource)
+{
+    return fclose(datasource);
+}
+
+static long file_tell(void *datasource)
+{
+    return ftell(datasource);
+}
+
+int source_file(struct source *src, const char *path)
+{
+    static const ov_callbacks file_callbacks = { file_read, file_seek, file_close, file_tell };
+    FILE *fp = fopen(path, "rb");
+
+    if (!fp)
+        return 0;
+
+    src->datasource = fp;
+    src->callbacks = file_callbacks;
+    src->seeks = NULL;
+    src->num_seeks = 0;
+    return 1;
+}
+
+void source_close(struct source *src)
+{
+    if (src->callbacks.close_func)
+        src->callbacks.close_func(src->datasource);
+}
+
+/* Ogg Vorbis */
+
+struct vf
+{
+    OggVorbis_File  ov;         /* first, the handle is passed to vorbisfile as it is */
+    const struct pak_seek *seeks;
+    DWORD           num_seeks;
+};
+
+static int vf_probe(const unsigned char *magic)
+{
+    return memcmp(magic, "OggS", 4) == 0;
+}
+
+static void *vf_open(struct source *src)
+{
+    struct vf *vf = malloc(sizeof *vf);
+
+    if (ov_open_callbacks(src->datasource, &vf->ov, NULL, 0, src->callbacks) != 0)
+    {
+        free(vf);
+        return NULL;
+    }
+
+    vf->seeks = src->seeks;
+    vf->num_seeks = src->num_seeks;
+    return vf;
+}
+
+static int vf_info(void *h, int *channels, long *rate, ogg_int64_t *total)
+{
+    vorbis_info *vi = ov_info(h, -1);
+
+    if (!vi)
+        return 0;
+
+    *channels = vi->channels;
+    *rate = vi->rate;
+    *total = ov_pcm_total(h, -1);
+    return 1;
+}
+
+static long vf_read(void *h, char *buf, int len)
+{
+#ifdef TREMOR
+    /* Tremor always returns 16-bit signed little endian samples */
+    int bitstream;
+    return ov_read(h, buf, len, &bitstream);
+#else
+    return ov_read(h, buf, len, 0, 2, 1, NULL);
+#endif
+}
+
+/* With the seek table of a packed track the stream is positioned on the
+   last page ending before the sample, with no bisection, and decoded up to
+   the sample from there. */
+static int vf_seek(void *h, ogg_int64_t sample)
+{
+    struct vf *vf = h;
+    DWORD lo = 0, hi = vf->num_seeks;
+
+    while (lo < hi)
+    {
+        DWORD mid = (lo + hi) / 2;
+
+        if (vf->seeks[mid].granule <= (ULONGLONG)sample)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if (lo == 0 || ov_raw_seek(&vf->ov, vf->seeks[lo - 1].offset) != 0)
+        return ov_pcm_seek(&vf->ov, sample);
+
+    vorbis_info *vi = ov_info(&vf->ov, -1);
+    ogg_int64_t pos = ov_pcm_tell(&vf->ov);
+    char buf[4096];
+
+    if (!vi || pos < 0 || pos > sample)
+        return ov_pcm_seek(&vf->ov, sample);
+
+    while (pos < sample)
+    {
+        ogg_int64_t want = (sample - pos) * vi->channels * 2;
+        long bytes = vf_read(h, buf, want < (ogg_int64_t)sizeof buf ? (int)want : (int)sizeof buf);
+
+        if (bytes == OV_HOLE)
+            continue;
+
+        if (bytes <= 0)
+            return OV_EINVAL;
+
+        pos += bytes / (vi->channels * 2);
+    }
+
+    return 0;
+}
+
+static const char *vf_comment(void *h, int i)
+{
+    vorbis_comment *vc = ov_comment(h, -1);
+    return vc && i < vc->comments ? vc->user_comments[i] : NULL;
+}
+
+static void vf_close(void *h)
+{
+    ov_clear(h);
+    free(h);
+}
+
+static const struct decoder decoder_vorbis =
+{
+#ifdef TREMOR
+    "Vorbis (Tremor)",
+#else
+    "Vorbis",
+#endif
+    vf_probe, vf_open, vf_info, vf_read, vf_seek, vf_comment, vf_close
+};
+
+/* FLAC */
+
+struct flac
+{
+    struct source   src;
+    drflac          *flac;
+    char            **comments;
+    int             num_comments;
+};
+
+static int flac_probe(const unsigned char *magic)
+{
+    return memcmp(magic, "fLaC", 4) == 0 || memcmp(magic, "OggS", 4) == 0;
+}
+
+static size_t flac_on_read(void *user, void *buf, size_t bytes)
+{
+    struct flac *f = user;
+    return f->src.callbacks.read_func(buf, 1, bytes, f->src.datasource);
+}
+
+static drflac_bool32 flac_on_seek(void *user, int offset, drflac_seek_origin origin)
+{
+    struct flac *f = user;
+    return f->src.callbacks.seek_func(f->src.datasource, offset, origin == drflac_seek_origin_start ? SEEK_SET : SEEK_CUR) == 0;
+}
+
+/* the comment block is only valid inside the callback, keep a copy */
+static void flac_on_meta(void *user, drflac_metadata *meta)
+{
+    struct flac *f = user;
+    drflac_vorbis_comment_iterator it;
+    const char *c;
+    drflac_uint32 len;
+
+    if (meta->type != DRFLAC_METADATA_BLOCK_TYPE_VORBIS_COMMENT || f->comments)
+        return;
+
+    f->comments = calloc(meta->data.vorbis_comment.commentCount + 1, sizeof *f->comments);
+    drflac_init_vorbis_comment_iterator(&it, meta->data.vorbis_comment.commentCount, meta->data.vorbis_comment.pComments);
+
+    while ((c = drflac_next_vorbis_comment(&it, &len)) != NULL)
+    {
+        char *copy = malloc(len + 1);
+        memcpy(copy, c, len);
+        copy[len] = '\0';
+        f->comments[f->num_comments++] = copy;
+    }
+}
+
+static void flac_free(struct flac *f)
+{
+    int i;
+
+    for (i = 0; i < f->num_comments; i++)
+        free(f->comments[i]);
+    free(f->comments);
+    free(f);
+}
+
+static void *flac_open(struct source *src)
+{
+    struct flac *f = calloc(1, sizeof *f);
+
+    f->src = *src;
+    f->flac = drflac_open_with_metadata(flac_on_read, flac_on_seek, flac_on_meta, f, NULL);
+
+    /* streams without a sample count in STREAMINFO can not be seeked in */
+    if (f->flac && f->flac->totalPCMFrameCount == 0)
+    {
+        drflac_close(f->flac);
+        f->flac = NULL;
+    }
+
+    if (!f->flac)
+    {
+        flac_free(f);
+        return NULL;
+    }
+
+    return f;
+}
+
+static int flac_info(void *h, int *channels, long *rate, ogg_int64_t *total)
+{
+    struct flac *f = h;
+
+    *channels = f->flac->channels;
+    *rate = f->flac->sampleRate;
+    *total = f->flac->totalPCMFrameCount;
+    return 1;
+}
+
+static long flac_read(void *h, char *buf, int len)
+{
+    struct flac *f = h;
+    int align = f->flac->channels * 2;
+
+    return (long)drflac_read_pcm_frames_s16(f->flac, len / align, (drflac_int16 *)buf) * align;
+}
+
+static int flac_seek(void *h, ogg_int64_t sample)
+{
+    struct flac *f = h;
+    return drflac_seek_to_pcm_frame(f->flac, sample) ? 0 : OV_EINVAL;
+}
+
+static const char *flac_comment(void *h, int i)
+{
+    struct flac *f = h;
+    return i < f->num_comments ? f->comments[i] : NULL;
+}
+
+static void flac_close(void *h)
+{
+    struct flac *f = h;
+
+    drflac_close(f->flac);
+    source_close(&f->src);
+    flac_free(f);
+}
+
+static const struct decoder decoder_flac =
+{
+    "FLAC", flac_probe, flac_open, flac_info, flac_read, flac_seek, flac_comment, flac_close
+};
+
+static const struct decoder *decoders[] = { &decoder_vorbis, &decoder_flac };
+
+/* Tries every decoder that recognizes the first bytes of the source. On
+   failure the source is left open for the caller to close. */
+const struct decoder *decoder_open(struct source *src, void **handle)
+{
+    unsigned char magic[4];
+    int i;
+
+    if (src->callbacks.read_func(magic, 1, 4, src->datasource) != 4)
+        return NULL;
+
+    for (i = 0; i < sizeof decoders / sizeof *decoders; i++)
+    {
+        if (!decoders[i]->probe(magic))
+            continue;
+
+        if (src->callbacks.seek_func(src->datasource, 0, SEEK_SET) != 0)
+            return NULL;
+
+        if ((*handle = decoders[i]->open(src)) != NULL)
+            return decoders[i];
+    }
+
+    return NULL;
+}
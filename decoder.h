@@ -0,0 +1,30 @@
+/* Track decoders (decoder.c)
+
+   A decoder reads its file through the callbacks of a source and returns
+   interleaved 16-bit little endian PCM. Errors are reported with the
+   vorbisfile OV_ codes for every decoder. */
+
+struct source
+{
+    void            *datasource;
+    ov_callbacks    callbacks;
+    const struct pak_seek *seeks;   /* page seek table of a packed track (pak.h) */
+    DWORD           num_seeks;
+};
+
+struct decoder
+{
+    const char      *name;
+    int             (*probe)(const unsigned char *magic);   /* first 4 bytes of the file */
+    void            *(*open)(struct source *src);           /* owns src when it succeeds */
+    int             (*info)(void *h, int *channels, long *rate, ogg_int64_t *total);
+    long            (*read)(void *h, char *buf, int len);
+    int             (*seek)(void *h, ogg_int64_t sample);
+    const char      *(*comment)(void *h, int i);            /* "KEY=value", NULL after the last */
+    void            (*close)(void *h);
+};
+
+int source_file(struct source *src, const char *path);
+void source_close(struct source *src);
+
+const struct decoder *decoder_open(struct source *src, void **handle);
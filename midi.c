@@ -0,0 +1,437 @@
+/* Pre-rendered music for games that play MIDI through midiStream.
+
+   With MidiMusic set, the first buffer a game queues on a MIDI stream
+   (after it is opened or stopped) is hashed, and when MUSIC\MIDI holds a
+   file named after the hash (e.g. 1A2B3C4D.ogg, .flac or .wav) that file
+   is played through the CD music player instead. While it plays, the
+   events of the stream are turned into no-ops in place before they are
+   passed on, so the real stream keeps the timing, the callbacks and the
+   positions the game expects but the synthesizer plays nothing. A muted
+   buffer queued again is restored first, so a song the player can not
+   take (or gave up) is heard on the synthesizer. Queueing the first buffer
+   again, as games do to loop a song, restarts the file.
+
+   Unknown songs play on the synthesizer as before, their hashes are
+   written to winmm.log for naming the renderings. The CD player is not
+   shared: songs are not replaced while a CD track plays, and playing one
+   stops the replacement (midi_yield()). */
+
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "player.h"
+#include "midi.h"
+
+/* generated thunks to the real functions (relay.s) */
+MMRESULT WINAPI relay_midiStreamOpen(LPHMIDISTRM a0, LPUINT a1, DWORD a2, DWORD a3, DWORD a4, DWORD a5);
+MMRESULT WINAPI relay_midiStreamClose(HMIDISTRM a0);
+MMRESULT WINAPI relay_midiStreamOut(HMIDISTRM a0, LPMIDIHDR a1, UINT a2);
+MMRESULT WINAPI relay_midiStreamPause(HMIDISTRM a0);
+MMRESULT WINAPI relay_midiStreamRestart(HMIDISTRM a0);
+MMRESULT WINAPI relay_midiStreamStop(HMIDISTRM a0);
+
+#define MIDI_STREAMS    4
+#define MIDI_HASH_BYTES 4096    /* of the first buffer */
+#define MIDI_SAVED      32      /* muted buffers that can be restored */
+
+#define dprintf(...) if (midi_log) { fprintf(midi_log, __VA_ARGS__); fflush(NULL); }
+
+struct midi_stream
+{
+    HMIDISTRM       hms;
+    int             probe;      /* the next buffer starts a song */
+    DWORD           song;       /* hash of its first buffer, when replaced */
+    char            path[MAX_PATH];
+    int             running;    /* restarted and not paused */
+};
+
+static int midi_enabled = 0;
+static char midi_dir[MAX_PATH];
+static FILE *midi_log = NULL;
+static struct midi_stream midi_streams[MIDI_STREAMS];
+static CRITICAL_SECTION midi_cs;
+
+/* The events are muted in the game's own buffers, which are queued again
+   as they are to loop a song or to play it after a stop. The original
+   events are kept until then, the hash tells whether the buffer still
+   holds what was muted. */
+struct midi_saved
+{
+    const char      *data;
+    DWORD           bytes;
+    DWORD           hash;       /* of the muted buffer */
+    DWORD           *events;    /* as they were, in order */
+};
+
+static struct midi_saved midi_saved[MIDI_SAVED];
+static int midi_saved_next = 0;
+
+/* the replacement playing in the CD player, at most one */
+static struct midi_stream *midi_owner = NULL;
+static HANDLE midi_thread = NULL;
+static volatile int midi_run = 0;
+static int midi_paused = 0;
+
+extern int playing;     /* CD audio, ogg-winmm.c */
+
+static struct midi_stream *midi_find(HMIDISTRM hms)
+{
+    int i;
+
+    for (i = 0; i < MIDI_STREAMS; i++)
+    {
+        if (midi_streams[i].hms && midi_streams[i].hms == hms)
+            return &midi_streams[i];
+    }
+
+    return NULL;
+}
+
+static DWORD midi_fnv(const char *data, DWORD len)
+{
+    const unsigned char *p = (const unsigned char *)data;
+    DWORD h = 2166136261u, i;
+
+    for (i = 0; i < len; i++)
+        h = (h ^ p[i]) * 16777619u;
+
+    return h;
+}
+
+static DWORD midi_hash(const MIDIHDR *hdr)
+{
+    return midi_fnv(hdr->lpData, hdr->dwBytesRecorded < MIDI_HASH_BYTES ? hdr->dwBytesRecorded : MIDI_HASH_BYTES);
+}
+
+static int midi_lookup(DWORD song, char *path)
+{
+    static const char *exts[] = { "ogg", "flac", "wav" };
+    int i;
+
+    for (i = 0; i < 3; i++)
+    {
+        snprintf(path, MAX_PATH, "%s\\%08X.%s", midi_dir, (unsigned int)song, exts[i]);
+        if (GetFileAttributes(path) != INVALID_FILE_ATTRIBUTES)
+            return 1;
+    }
+
+    return 0;
+}
+
+/* Short and long messages become NOP and comment events of the same size,
+   tempo changes and callbacks stay. The buffer is left as it is when
+   there is no memory to keep the events. */
+static void midi_mute(MIDIHDR *hdr)
+{
+    DWORD offset = 0, num = 0;
+    DWORD *events = malloc((hdr->dwBytesRecorded / 12 + 1) * sizeof(DWORD));
+    struct midi_saved *m = NULL;
+    int i;
+
+    if (!events)
+        return;
+
+    while (offset + 12 <= hdr->dwBytesRecorded)
+    {
+        DWORD *event = (DWORD *)(hdr->lpData + offset + 8);
+        BYTE type = (BYTE)(*event >> 24) & ~(MEVT_F_CALLBACK >> 24);
+
+        events[num++] = *event;
+
+        if (type == MEVT_SHORTMSG)
+            *event = (*event & MEVT_F_CALLBACK) | ((DWORD)MEVT_NOP << 24);
+        else if (type == MEVT_LONGMSG)
+            *event = (*event & (MEVT_F_CALLBACK | 0xFFFFFF)) | ((DWORD)MEVT_COMMENT << 24);
+
+        offset += 12;
+        if (*event & MEVT_F_LONG)
+            offset += ((*event & 0xFFFFFF) + 3) & ~3;
+    }
+
+    /* a buffer refilled by the game replaces what was kept for it */
+    for (i = 0; i < MIDI_SAVED && !m; i++)
+    {
+        if (midi_saved[i].events && midi_saved[i].data == hdr->lpData)
+            m = &midi_saved[i];
+    }
+
+    if (!m)
+    {
+        m = &midi_saved[midi_saved_next];
+        midi_saved_next = (midi_saved_next + 1) % MIDI_SAVED;
+    }
+
+    free(m->events);
+    m->data = hdr->lpData;
+    m->bytes = hdr->dwBytesRecorded;
+    m->hash = midi_fnv(hdr->lpData, hdr->dwBytesRecorded);
+    m->events = events;
+}
+
+/* puts back the events of a buffer muted before */
+static void midi_unmute(MIDIHDR *hdr)
+{
+    DWORD offset = 0, num = 0;
+    int i;
+
+    for (i = 0; i < MIDI_SAVED; i++)
+    {
+        struct midi_saved *m = &midi_saved[i];
+
+        if (!m->events || m->data != hdr->lpData || m->bytes != hdr->dwBytesRecorded
+            || m->hash != midi_fnv(hdr->lpData, hdr->dwBytesRecorded))
+            continue;
+
+        while (offset + 12 <= hdr->dwBytesRecorded)
+        {
+            DWORD *event = (DWORD *)(hdr->lpData + offset + 8);
+
+            *event = m->events[num++];
+
+            offset += 12;
+            if (*event & MEVT_F_LONG)
+                offset += ((*event & 0xFFFFFF) + 3) & ~3;
+        }
+
+        free(m->events);
+        memset(m, 0, sizeof *m);
+        return;
+    }
+}
+
+static DWORD WINAPI midi_main(LPVOID param)
+{
+    while (midi_run && plr_pump());
+    return 0;
+}
+
+/* stops the replacement, called locked */
+static void midi_halt()
+{
+    if (!midi_owner)
+        return;
+
+    if (midi_thread)
+    {
+        midi_run = 0;
+        if (midi_paused)
+            plr_pause(0);
+        WaitForSingleObject(midi_thread, INFINITE);
+        CloseHandle(midi_thread);
+        midi_thread = NULL;
+    }
+
+    plr_stop();
+    midi_owner = NULL;
+    midi_paused = 0;
+}
+
+/* (re)starts the song of s from the beginning, held until the stream is
+   restarted when it is paused, called locked. Without the CD player the
+   song is left to the synthesizer. */
+static void midi_start(struct midi_stream *s)
+{
+    midi_halt();
+
+    if (playing || !plr_play(s->path))
+        return;
+
+    dprintf("MIDI song %08X replaced by %s\r\n", (unsigned int)s->song, s->path);
+
+    midi_owner = s;
+    if (!s->running)
+    {
+        plr_pause(1);
+        midi_paused = 1;
+    }
+    midi_run = 1;
+    midi_thread = CreateThread(NULL, 0, midi_main, NULL, 0, NULL);
+}
+
+void midi_enable(const char *dir, FILE *log)
+{
+    if (midi_enabled)
+        return;
+
+    InitializeCriticalSection(&midi_cs);
+    snprintf(midi_dir, sizeof midi_dir, "%s", dir);
+    midi_log = log;
+    midi_enabled = 1;
+}
+
+/* the CD player is about to be used for a CD track */
+void midi_yield()
+{
+    if (!midi_enabled)
+        return;
+
+    EnterCriticalSection(&midi_cs);
+    midi_halt();
+    LeaveCriticalSection(&midi_cs);
+}
+
+MMRESULT WINAPI fake_midiStreamOpen(LPHMIDISTRM a0, LPUINT a1, DWORD a2, DWORD a3, DWORD a4, DWORD a5)
+{
+    MMRESULT ret = relay_midiStreamOpen(a0, a1, a2, a3, a4, a5);
+    int i;
+
+    if (!midi_enabled || ret != MMSYSERR_NOERROR)
+        return ret;
+
+    EnterCriticalSection(&midi_cs);
+
+    for (i = 0; i < MIDI_STREAMS; i++)
+    {
+        if (!midi_streams[i].hms)
+        {
+            memset(&midi_streams[i], 0, sizeof midi_streams[i]);
+            midi_streams[i].hms = *(HMIDISTRM *)a0;
+            midi_streams[i].probe = 1;
+            break;
+        }
+    }
+
+    LeaveCriticalSection(&midi_cs);
+    return ret;
+}
+
+MMRESULT WINAPI fake_midiStreamOut(HMIDISTRM a0, LPMIDIHDR a1, UINT a2)
+{
+    struct midi_stream *s;
+
+    if (!midi_enabled || !a1 || !a1->lpData)
+        return relay_midiStreamOut(a0, a1, a2);
+
+    EnterCriticalSection(&midi_cs);
+
+    if ((s = midi_find(a0)) != NULL)
+    {
+        midi_unmute(a1);
+
+        DWORD hash = midi_hash(a1);
+
+        if (s->probe)
+        {
+            s->probe = 0;
+            s->song = 0;
+
+            if (midi_lookup(hash, s->path))
+            {
+                s->song = hash;
+                midi_start(s);
+            }
+            else
+            {
+                dprintf("MIDI song %08X has no replacement in %s\r\n", (unsigned int)hash, midi_dir);
+            }
+        }
+        else if (s->song && hash == s->song)
+        {
+            midi_start(s);
+        }
+
+        /* only while the replacement plays, the synthesizer keeps it otherwise */
+        if (midi_owner == s)
+            midi_mute(a1);
+    }
+
+    LeaveCriticalSection(&midi_cs);
+
+    return relay_midiStreamOut(a0, a1, a2);
+}
+
+MMRESULT WINAPI fake_midiStreamRestart(HMIDISTRM a0)
+{
+    struct midi_stream *s;
+
+    if (!midi_enabled)
+        return relay_midiStreamRestart(a0);
+
+    EnterCriticalSection(&midi_cs);
+
+    if ((s = midi_find(a0)) != NULL && !s->running)
+    {
+        s->running = 1;
+
+        if (midi_owner == s && midi_paused)
+        {
+            plr_pause(0);
+            midi_paused = 0;
+        }
+    }
+
+    LeaveCriticalSection(&midi_cs);
+
+    return relay_midiStreamRestart(a0);
+}
+
+MMRESULT WINAPI fake_midiStreamPause(HMIDISTRM a0)
+{
+    struct midi_stream *s;
+
+    if (!midi_enabled)
+        return relay_midiStreamPause(a0);
+
+    EnterCriticalSection(&midi_cs);
+
+    if ((s = midi_find(a0)) != NULL)
+    {
+        s->running = 0;
+
+        if (midi_owner == s && !midi_paused)
+        {
+            plr_pause(1);
+            midi_paused = 1;
+        }
+    }
+
+    LeaveCriticalSection(&midi_cs);
+
+    return relay_midiStreamPause(a0);
+}
+
+MMRESULT WINAPI fake_midiStreamStop(HMIDISTRM a0)
+{
+    struct midi_stream *s;
+
+    if (!midi_enabled)
+        return relay_midiStreamStop(a0);
+
+    EnterCriticalSection(&midi_cs);
+
+    if ((s = midi_find(a0)) != NULL)
+    {
+        if (midi_owner == s)
+            midi_halt();
+
+        /* the position goes back to zero, the next buffer may be a new song */
+        s->probe = 1;
+        s->song = 0;
+    }
+
+    LeaveCriticalSection(&midi_cs);
+
+    return relay_midiStreamStop(a0);
+}
+
+MMRESULT WINAPI fake_midiStreamClose(HMIDISTRM a0)
+{
+    struct midi_stream *s;
+
+    if (!midi_enabled)
+        return relay_midiStreamClose(a0);
+
+    EnterCriticalSection(&midi_cs);
+
+    if ((s = midi_find(a0)) != NULL)
+    {
+        if (midi_owner == s)
+            midi_halt();
+        s->hms = NULL;
+    }
+
+    LeaveCriticalSection(&midi_cs);
+
+    return relay_midiStreamClose(a0);
+}
@@ -0,0 +1,4 @@
+/* Pre-rendered replacements for MIDI music (midi.c) */
+
+void midi_enable(const char *dir, FILE *log);
+void midi_yield();
@@ -0,0 +1,760 @@
+/* Software mixer for the waveOut streams of the process.
+
+   With MixWaveOut set to a rate, every PCM stream the game opens (and the
+   CD music of player.c, and the effects of sound.c, which open theirs
+   through the same exports) becomes a virtual handle of this mixer instead
+   of a device of its own. The streams are converted to float stereo at the
+   mix rate (linear interpolation when the rates differ), summed with their
+   waveOutSetVolume gain and written as 16-bit to one real device, in
+   MIX_BLOCKS blocks of 20 ms. So there is a single device and a single
+   queue, and a sound effect is heard within a block or two instead of
+   after the latency of a device of its own.
+
+   Formats other than 8 or 16-bit PCM in one or two channels, and streams
+   opened before the option is read, are left to the real winmm.dll. Loops
+   are supported within a single buffer (WHDR_BEGINLOOP and WHDR_ENDLOOP
+   on the same header), the position is counted as the stream is mixed,
+   up to MIX_BLOCKS blocks before it is heard. */
+
+#include <windows.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <xmmintrin.h>
+#include <emmintrin.h>
+#include "mixer.h"
+
+/* generated thunks to the real functions (relay.s) */
+MMRESULT WINAPI relay_waveOutOpen(LPHWAVEOUT a0, UINT a1, LPCWAVEFORMATEX a2, DWORD a3, DWORD a4, DWORD a5);
+MMRESULT WINAPI relay_waveOutClose(HWAVEOUT a0);
+MMRESULT WINAPI relay_waveOutPrepareHeader(HWAVEOUT a0, LPWAVEHDR a1, UINT a2);
+MMRESULT WINAPI relay_waveOutUnprepareHeader(HWAVEOUT a0, LPWAVEHDR a1, UINT a2);
+MMRESULT WINAPI relay_waveOutWrite(HWAVEOUT a0, LPWAVEHDR a1, UINT a2);
+MMRESULT WINAPI relay_waveOutPause(HWAVEOUT a0);
+MMRESULT WINAPI relay_waveOutRestart(HWAVEOUT a0);
+MMRESULT WINAPI relay_waveOutReset(HWAVEOUT a0);
+MMRESULT WINAPI relay_waveOutBreakLoop(HWAVEOUT a0);
+MMRESULT WINAPI relay_waveOutGetPosition(HWAVEOUT a0, LPMMTIME a1, UINT a2);
+MMRESULT WINAPI relay_waveOutGetVolume(HWAVEOUT a0, PDWORD a1);
+MMRESULT WINAPI relay_waveOutSetVolume(HWAVEOUT a0, DWORD a1);
+MMRESULT WINAPI relay_waveOutGetPitch(HWAVEOUT a0, PDWORD a1);
+MMRESULT WINAPI relay_waveOutSetPitch(HWAVEOUT a0, DWORD a1);
+MMRESULT WINAPI relay_waveOutGetPlaybackRate(HWAVEOUT a0, PDWORD a1);
+MMRESULT WINAPI relay_waveOutSetPlaybackRate(HWAVEOUT a0, DWORD a1);
+MMRESULT WINAPI relay_waveOutGetID(HWAVEOUT a0, LPUINT a1);
+MMRESULT WINAPI relay_waveOutMessage(HWAVEOUT a0, UINT a1, DWORD a2, DWORD a3);
+
+#define MIX_STREAMS     32
+#define MIX_BLOCKS      4
+#define MIX_DONE_MAX    256     /* buffers returned per block */
+
+struct mix_stream
+{
+    WAVEFORMATEX    fmt;
+    DWORD           callback;
+    DWORD           instance;
+    DWORD           type;       /* CALLBACK_ type of the open flags */
+    WAVEHDR         *head;      /* queue, linked through lpNext */
+    WAVEHDR         *tail;
+    DWORD           offset;     /* in head */
+    DWORD           loops;      /* left for head */
+    int             started;    /* head has been started */
+    int             paused;
+    DWORD           step;       /* input frames per output frame, 16.16 */
+    DWORD           frac;
+    float           prev[2];    /* the frames interpolated between */
+    float           cur[2];
+    DWORD           played;     /* bytes */
+    DWORD           volume;     /* left in the low word, right in the high one */
+};
+
+/* a buffer to give back once the lock is released */
+struct mix_done
+{
+    HWAVEOUT        hwo;
+    DWORD           callback;
+    DWORD           instance;
+    DWORD           type;
+    WAVEHDR         *header;
+};
+
+static DWORD mix_rate = 0;      /* 0 when disabled */
+static DWORD mix_frames;        /* per block */
+static struct mix_stream *mix_streams[MIX_STREAMS];
+static CRITICAL_SECTION mix_cs;
+static HWAVEOUT mix_hwo = NULL;
+static HANDLE mix_event = NULL;
+static HANDLE mix_thread = NULL;
+static WAVEHDR mix_blocks[MIX_BLOCKS];
+static float *mix_acc;          /* the sum of a block */
+static float *mix_tmp;          /* one stream of a block */
+static struct mix_done mix_done[MIX_DONE_MAX];
+static int mix_num_done;
+
+/* called locked, a stream is freed by fake_waveOutClose() */
+static struct mix_stream *mix_find(HWAVEOUT hwo)
+{
+    int i;
+
+    for (i = 0; i < MIX_STREAMS; i++)
+    {
+        if (mix_streams[i] && (HWAVEOUT)mix_streams[i] == hwo)
+            return mix_streams[i];
+    }
+
+    return NULL;
+}
+
+/* the stream of hwo with the lock held, or NULL unlocked */
+static struct mix_stream *mix_lock(HWAVEOUT hwo)
+{
+    struct mix_stream *s;
+
+    if (!mix_rate || !hwo)
+        return NULL;
+
+    EnterCriticalSection(&mix_cs);
+
+    if (!(s = mix_find(hwo)))
+        LeaveCriticalSection(&mix_cs);
+
+    return s;
+}
+
+/* for the calls that only need to know whether hwo is a stream */
+static int mix_known(HWAVEOUT hwo)
+{
+    if (!mix_lock(hwo))
+        return 0;
+
+    LeaveCriticalSection(&mix_cs);
+    return 1;
+}
+
+static void mix_notify(HWAVEOUT hwo, DWORD type, DWORD callback, DWORD instance, UINT msg, WAVEHDR *header)
+{
+    switch (type)
+    {
+        case CALLBACK_WINDOW:
+            PostMessage((HWND)callback, msg, (WPARAM)hwo, (LPARAM)header);
+            break;
+        case CALLBACK_THREAD:
+            PostThreadMessage(callback, msg, (WPARAM)hwo, (LPARAM)header);
+            break;
+        case CALLBACK_FUNCTION:
+            ((void (CALLBACK *)(HWAVEOUT, UINT, DWORD, DWORD, DWORD))callback)(hwo, msg, instance, (DWORD)header, 0);
+            break;
+        case CALLBACK_EVENT:
+            SetEvent((HANDLE)callback);
+            break;
+    }
+}
+
+/* called unlocked, callbacks may write the next buffer */
+static void mix_give_back(struct mix_done *done, int num)
+{
+    int i;
+
+    for (i = 0; i < num; i++)
+        mix_notify(done[i].hwo, done[i].type, done[i].callback, done[i].instance, WOM_DONE, done[i].header);
+}
+
+/* takes the head off the queue, 0 when there is no room to give it back */
+static int mix_retire(struct mix_stream *s)
+{
+    WAVEHDR *h = s->head;
+
+    if (mix_num_done == MIX_DONE_MAX)
+        return 0;
+
+    s->head = (WAVEHDR *)h->lpNext;
+    if (!s->head)
+        s->tail = NULL;
+    s->offset = 0;
+    s->started = 0;
+
+    h->lpNext = NULL;
+    h->dwFlags = (h->dwFlags & ~WHDR_INQUEUE) | WHDR_DONE;
+
+    mix_done[mix_num_done].hwo = (HWAVEOUT)s;
+    mix_done[mix_num_done].callback = s->callback;
+    mix_done[mix_num_done].instance = s->instance;
+    mix_done[mix_num_done].type = s->type;
+    mix_done[mix_num_done].header = h;
+    mix_num_done++;
+    return 1;
+}
+
+/* the head with data left, looping or retiring the ones played through */
+static WAVEHDR *mix_head(struct mix_stream *s)
+{
+    WAVEHDR *h;
+
+    while ((h = s->head) != NULL)
+    {
+        if (!s->started)
+        {
+            s->started = 1;
+            s->loops = (h->dwFlags & (WHDR_BEGINLOOP | WHDR_ENDLOOP)) == (WHDR_BEGINLOOP | WHDR_ENDLOOP) ? h->dwLoops : 1;
+        }
+
+        if (s->offset + s->fmt.nBlockAlign <= h->dwBufferLength)
+            return h;
+
+        if (s->loops > 1)
+        {
+            s->loops--;
+            s->offset = 0;
+            if (h->dwBufferLength >= s->fmt.nBlockAlign)
+                continue;
+        }
+
+        if (!mix_retire(s))
+            return NULL;
+    }
+
+    return NULL;
+}
+
+static void mix_frame(const struct mix_stream *s, const char *p, float *out)
+{
+    if (s->fmt.wBitsPerSample == 16)
+    {
+        out[0] = ((const short *)p)[0];
+        out[1] = ((const short *)p)[s->fmt.nChannels - 1];
+    }
+    else
+    {
+        out[0] = (((const unsigned char *)p)[0] - 128) * 256.0f;
+        out[1] = (((const unsigned char *)p)[s->fmt.nChannels - 1] - 128) * 256.0f;
+    }
+}
+
+/* converts up to frames of a stream to float stereo at the mix rate,
+   returns how many it had */
+static DWORD mix_convert(struct mix_stream *s, float *out, DWORD frames)
+{
+    DWORD done = 0;
+    WAVEHDR *h;
+
+    if (s->step == 0x10000)
+    {
+        while (done < frames && (h = mix_head(s)) != NULL)
+        {
+            DWORD n = (h->dwBufferLength - s->offset) / s->fmt.nBlockAlign, i;
+            const char *p = h->lpData + s->offset;
+
+            if (n > frames - done)
+                n = frames - done;
+
+            for (i = 0; i < n; i++, p += s->fmt.nBlockAlign)
+                mix_frame(s, p, out + (done + i) * 2);
+
+            s->offset += n * s->fmt.nBlockAlign;
+            s->played += n * s->fmt.nBlockAlign;
+            done += n;
+        }
+
+        return done;
+    }
+
+    for (; done < frames; done++)
+    {
+        while (s->frac >= 0x10000)
+        {
+            if (!(h = mix_head(s)))
+                return done;
+
+            s->prev[0] = s->cur[0];
+            s->prev[1] = s->cur[1];
+            mix_frame(s, h->lpData + s->offset, s->cur);
+            s->offset += s->fmt.nBlockAlign;
+            s->played += s->fmt.nBlockAlign;
+            s->frac -= 0x10000;
+        }
+
+        float t = s->frac * (1.0f / 0x10000);
+        out[done * 2] = s->prev[0] + (s->cur[0] - s->prev[0]) * t;
+        out[done * 2 + 1] = s->prev[1] + (s->cur[1] - s->prev[1]) * t;
+        s->frac += s->step;
+    }
+
+    return done;
+}
+
+/* The SSE versions are compiled for SSE whatever the build flags and
+   picked by mixer_enable() when the processor has it. The stack of a 32-bit
+   thread is only 4-byte aligned, so they realign it for their spills. */
+#define MIX_SSE     __attribute__((target("sse"), force_align_arg_pointer))
+#define MIX_SSE2    __attribute__((target("sse2"), force_align_arg_pointer))
+
+static void mix_add_c(float *acc, const float *in, DWORD frames, float left, float right)
+{
+    DWORD i;
+
+    for (i = 0; i < frames; i++)
+    {
+        acc[i * 2] += in[i * 2] * left;
+        acc[i * 2 + 1] += in[i * 2 + 1] * right;
+    }
+}
+
+static MIX_SSE void mix_add_sse(float *acc, const float *in, DWORD frames, float left, float right)
+{
+    __m128 gain = _mm_setr_ps(left, right, left, right);
+    DWORD i = 0;
+
+    for (; i + 2 <= frames; i += 2)
+        _mm_storeu_ps(acc + i * 2, _mm_add_ps(_mm_loadu_ps(acc + i * 2), _mm_mul_ps(_mm_loadu_ps(in + i * 2), gain)));
+
+    mix_add_c(acc + i * 2, in + i * 2, frames - i, left, right);
+}
+
+static void mix_store_c(short *out, const float *acc, DWORD samples)
+{
+    DWORD i;
+
+    for (i = 0; i < samples; i++)
+    {
+        float v = acc[i];
+        out[i] = v > 32767.0f ? 32767 : v < -32768.0f ? -32768 : (short)lrintf(v);
+    }
+}
+
+static MIX_SSE2 void mix_store_sse2(short *out, const float *acc, DWORD samples)
+{
+    DWORD i = 0;
+
+    /* cvtps rounds to nearest, packs saturates to 16 bits */
+    for (; i + 8 <= samples; i += 8)
+    {
+        __m128i a = _mm_cvtps_epi32(_mm_loadu_ps(acc + i));
+        __m128i b = _mm_cvtps_epi32(_mm_loadu_ps(acc + i + 4));
+        _mm_storeu_si128((__m128i *)(out + i), _mm_packs_epi32(a, b));
+    }
+
+    mix_store_c(out + i, acc + i, samples - i);
+}
+
+static void (*mix_add)(float *acc, const float *in, DWORD frames, float left, float right) = mix_add_c;
+static void (*mix_store)(short *out, const float *acc, DWORD samples) = mix_store_c;
+
+static void mix_block(WAVEHDR *block)
+{
+    int i;
+
+    memset(mix_acc, 0, sizeof(float) * mix_frames * 2);
+
+    for (i = 0; i < MIX_STREAMS; i++)
+    {
+        struct mix_stream *s = mix_streams[i];
+
+        if (!s || s->paused || !s->head)
+            continue;
+
+        DWORD got = mix_convert(s, mix_tmp, mix_frames);
+
+        if (got && s->volume)
+            mix_add(mix_acc, mix_tmp, got, LOWORD(s->volume) / 65535.0f, HIWORD(s->volume) / 65535.0f);
+    }
+
+    mix_store((short *)block->lpData, mix_acc, mix_frames * 2);
+}
+
+static DWORD WINAPI mix_main(LPVOID param)
+{
+    struct mix_done done[MIX_DONE_MAX];
+    int i, num;
+
+    while (1)
+    {
+        WaitForSingleObject(mix_event, INFINITE);
+
+        EnterCriticalSection(&mix_cs);
+
+        for (i = 0; i < MIX_BLOCKS; i++)
+        {
+            if (!(mix_blocks[i].dwFlags & WHDR_DONE))
+                continue;
+
+            mix_block(&mix_blocks[i]);
+            relay_waveOutWrite(mix_hwo, &mix_blocks[i], sizeof(WAVEHDR));
+        }
+
+        num = mix_num_done;
+        memcpy(done, mix_done, sizeof(struct mix_done) * num);
+        mix_num_done = 0;
+
+        LeaveCriticalSection(&mix_cs);
+
+        mix_give_back(done, num);
+    }
+
+    return 0;
+}
+
+/* opens the real device on the first stream, called locked */
+static int mix_start()
+{
+    WAVEFORMATEX fmt;
+    int i;
+
+    if (mix_hwo)
+        return 1;
+
+    fmt.wFormatTag = WAVE_FORMAT_PCM;
+    fmt.nChannels = 2;
+    fmt.nSamplesPerSec = mix_rate;
+    fmt.wBitsPerSample = 16;
+    fmt.nBlockAlign = 4;
+    fmt.nAvgBytesPerSec = mix_rate * 4;
+    fmt.cbSize = 0;
+
+    mix_event = CreateEvent(NULL, FALSE, FALSE, NULL);
+
+    if (relay_waveOutOpen((LPHWAVEOUT)&mix_hwo, WAVE_MAPPER, &fmt, (DWORD)mix_event, 0, CALLBACK_EVENT) != MMSYSERR_NOERROR)
+    {
+        CloseHandle(mix_event);
+        mix_event = NULL;
+        mix_hwo = NULL;
+        return 0;
+    }
+
+    mix_frames = (mix_rate / 50) & ~1;
+    mix_acc = malloc(sizeof(float) * mix_frames * 2);
+    mix_tmp = malloc(sizeof(float) * mix_frames * 2);
+
+    for (i = 0; i < MIX_BLOCKS; i++)
+    {
+        memset(&mix_blocks[i], 0, sizeof(WAVEHDR));
+        mix_blocks[i].lpData = calloc(mix_frames, 4);
+        mix_blocks[i].dwBufferLength = mix_frames * 4;
+        relay_waveOutPrepareHeader(mix_hwo, &mix_blocks[i], sizeof(WAVEHDR));
+        mix_blocks[i].dwFlags |= WHDR_DONE;
+    }
+
+    /* the first pass fills all the blocks */
+    SetEvent(mix_event);
+    mix_thread = CreateThread(NULL, 0, mix_main, NULL, 0, NULL);
+    SetThreadPriority(mix_thread, THREAD_PRIORITY_TIME_CRITICAL);
+    return 1;
+}
+
+void mixer_enable(int rate)
+{
+    if (mix_rate || rate < 8000)
+        return;
+
+    if (IsProcessorFeaturePresent(PF_XMMI_INSTRUCTIONS_AVAILABLE))
+        mix_add = mix_add_sse;
+    if (IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE))
+        mix_store = mix_store_sse2;
+
+    InitializeCriticalSection(&mix_cs);
+    mix_rate = rate;
+}
+
+static int mix_supported(LPCWAVEFORMATEX fmt)
+{
+    return fmt && fmt->wFormatTag == WAVE_FORMAT_PCM && (fmt->wBitsPerSample == 8 || fmt->wBitsPerSample == 16)
+        && (fmt->nChannels == 1 || fmt->nChannels == 2) && fmt->nSamplesPerSec >= 1000 && fmt->nSamplesPerSec <= 192000
+        && fmt->nBlockAlign == fmt->nChannels * fmt->wBitsPerSample / 8;
+}
+
+MMRESULT WINAPI fake_waveOutOpen(LPHWAVEOUT a0, UINT a1, LPCWAVEFORMATEX a2, DWORD a3, DWORD a4, DWORD a5)
+{
+    struct mix_stream *s;
+    int i;
+
+    if (!mix_rate || !mix_supported(a2))
+        return relay_waveOutOpen(a0, a1, a2, a3, a4, a5);
+
+    if (a5 & WAVE_FORMAT_QUERY)
+        return MMSYSERR_NOERROR;
+
+    EnterCriticalSection(&mix_cs);
+
+    for (i = 0; i < MIX_STREAMS && mix_streams[i]; i++);
+
+    if (i == MIX_STREAMS || !mix_start())
+    {
+        LeaveCriticalSection(&mix_cs);
+        return relay_waveOutOpen(a0, a1, a2, a3, a4, a5);
+    }
+
+    s = calloc(1, sizeof *s);
+    s->fmt = *a2;
+    s->fmt.cbSize = 0;
+    s->callback = a3;
+    s->instance = a4;
+    s->type = a5 & CALLBACK_TYPEMASK;
+    s->step = (DWORD)(((ULONGLONG)a2->nSamplesPerSec << 16) / mix_rate);
+    s->frac = 0x10000;
+    s->volume = 0xFFFFFFFF;
+    mix_streams[i] = s;
+
+    LeaveCriticalSection(&mix_cs);
+
+    *(HWAVEOUT *)a0 = (HWAVEOUT)s;
+    mix_notify((HWAVEOUT)s, s->type, s->callback, s->instance, WOM_OPEN, NULL);
+    return MMSYSERR_NOERROR;
+}
+
+MMRESULT WINAPI fake_waveOutClose(HWAVEOUT a0)
+{
+    struct mix_stream *s = mix_lock(a0);
+    int i;
+
+    if (!s)
+        return relay_waveOutClose(a0);
+
+    if (s->head)
+    {
+        LeaveCriticalSection(&mix_cs);
+        return WAVERR_STILLPLAYING;
+    }
+
+    for (i = 0; i < MIX_STREAMS; i++)
+    {
+        if (mix_streams[i] == s)
+            mix_streams[i] = NULL;
+    }
+
+    LeaveCriticalSection(&mix_cs);
+
+    mix_notify(a0, s->type, s->callback, s->instance, WOM_CLOSE, NULL);
+    free(s);
+    return MMSYSERR_NOERROR;
+}
+
+MMRESULT WINAPI fake_waveOutPrepareHeader(HWAVEOUT a0, LPWAVEHDR a1, UINT a2)
+{
+    if (!mix_known(a0))
+        return relay_waveOutPrepareHeader(a0, a1, a2);
+
+    if (!a1 || a2 < sizeof(WAVEHDR))
+        return MMSYSERR_INVALPARAM;
+
+    a1->dwFlags |= WHDR_PREPARED;
+    return MMSYSERR_NOERROR;
+}
+
+MMRESULT WINAPI fake_waveOutUnprepareHeader(HWAVEOUT a0, LPWAVEHDR a1, UINT a2)
+{
+    if (!mix_known(a0))
+        return relay_waveOutUnprepareHeader(a0, a1, a2);
+
+    if (!a1 || a2 < sizeof(WAVEHDR))
+        return MMSYSERR_INVALPARAM;
+
+    if (a1->dwFlags & WHDR_INQUEUE)
+        return WAVERR_STILLPLAYING;
+
+    a1->dwFlags &= ~WHDR_PREPARED;
+    return MMSYSERR_NOERROR;
+}
+
+MMRESULT WINAPI fake_waveOutWrite(HWAVEOUT a0, LPWAVEHDR a1, UINT a2)
+{
+    struct mix_stream *s = mix_lock(a0);
+    MMRESULT ret = MMSYSERR_NOERROR;
+
+    if (!s)
+        return relay_waveOutWrite(a0, a1, a2);
+
+    if (!a1 || a2 < sizeof(WAVEHDR))
+        ret = MMSYSERR_INVALPARAM;
+    else if (!(a1->dwFlags & WHDR_PREPARED))
+        ret = WAVERR_UNPREPARED;
+    else if (a1->dwFlags & WHDR_INQUEUE)
+        ret = WAVERR_STILLPLAYING;
+
+    if (ret != MMSYSERR_NOERROR)
+    {
+        LeaveCriticalSection(&mix_cs);
+        return ret;
+    }
+
+    a1->dwFlags = (a1->dwFlags & ~WHDR_DONE) | WHDR_INQUEUE;
+    a1->lpNext = NULL;
+
+    if (s->tail)
+        s->tail->lpNext = a1;
+    else
+        s->head = a1;
+    s->tail = a1;
+
+    LeaveCriticalSection(&mix_cs);
+    return MMSYSERR_NOERROR;
+}
+
+MMRESULT WINAPI fake_waveOutPause(HWAVEOUT a0)
+{
+    struct mix_stream *s = mix_lock(a0);
+
+    if (!s)
+        return relay_waveOutPause(a0);
+
+    s->paused = 1;
+    LeaveCriticalSection(&mix_cs);
+    return MMSYSERR_NOERROR;
+}
+
+MMRESULT WINAPI fake_waveOutRestart(HWAVEOUT a0)
+{
+    struct mix_stream *s = mix_lock(a0);
+
+    if (!s)
+        return relay_waveOutRestart(a0);
+
+    s->paused = 0;
+    LeaveCriticalSection(&mix_cs);
+    return MMSYSERR_NOERROR;
+}
+
+/* returns every queued buffer before it returns, like the real one. The
+   queue is taken off the stream and given back unlocked, so there is no
+   limit on its length and the callbacks may queue buffers again. */
+MMRESULT WINAPI fake_waveOutReset(HWAVEOUT a0)
+{
+    struct mix_stream *s = mix_lock(a0);
+    DWORD callback, instance, type;
+    WAVEHDR *h, *next;
+
+    if (!s)
+        return relay_waveOutReset(a0);
+
+    h = s->head;
+    callback = s->callback;
+    instance = s->instance;
+    type = s->type;
+
+    s->head = NULL;
+    s->tail = NULL;
+    s->offset = 0;
+    s->started = 0;
+    s->played = 0;
+    s->frac = 0x10000;
+    memset(s->cur, 0, sizeof s->cur);
+    s->paused = 0;
+
+    LeaveCriticalSection(&mix_cs);
+
+    for (; h; h = next)
+    {
+        next = (WAVEHDR *)h->lpNext;
+        h->lpNext = NULL;
+        h->dwFlags = (h->dwFlags & ~WHDR_INQUEUE) | WHDR_DONE;
+        mix_notify(a0, type, callback, instance, WOM_DONE, h);
+    }
+
+    return MMSYSERR_NOERROR;
+}
+
+MMRESULT WINAPI fake_waveOutBreakLoop(HWAVEOUT a0)
+{
+    struct mix_stream *s = mix_lock(a0);
+
+    if (!s)
+        return relay_waveOutBreakLoop(a0);
+
+    s->loops = 1;
+    LeaveCriticalSection(&mix_cs);
+    return MMSYSERR_NOERROR;
+}
+
+MMRESULT WINAPI fake_waveOutGetPosition(HWAVEOUT a0, LPMMTIME a1, UINT a2)
+{
+    struct mix_stream *s = mix_lock(a0);
+
+    if (!s)
+        return relay_waveOutGetPosition(a0, a1, a2);
+
+    DWORD played = s->played, align = s->fmt.nBlockAlign, rate = s->fmt.nAvgBytesPerSec;
+    LeaveCriticalSection(&mix_cs);
+
+    if (!a1 || a2 < sizeof(MMTIME))
+        return MMSYSERR_INVALPARAM;
+
+    switch (a1->wType)
+    {
+        case TIME_SAMPLES:
+            a1->u.sample = played / align;
+            break;
+        case TIME_MS:
+            a1->u.ms = (DWORD)((ULONGLONG)played * 1000 / rate);
+            break;
+        default:
+            a1->wType = TIME_BYTES;
+            a1->u.cb = played;
+            break;
+    }
+
+    return MMSYSERR_NOERROR;
+}
+
+MMRESULT WINAPI fake_waveOutGetVolume(HWAVEOUT a0, PDWORD a1)
+{
+    struct mix_stream *s = mix_lock(a0);
+
+    if (!s)
+        return relay_waveOutGetVolume(a0, a1);
+
+    DWORD volume = s->volume;
+    LeaveCriticalSection(&mix_cs);
+
+    if (!a1)
+        return MMSYSERR_INVALPARAM;
+
+    *a1 = volume;
+    return MMSYSERR_NOERROR;
+}
+
+MMRESULT WINAPI fake_waveOutSetVolume(HWAVEOUT a0, DWORD a1)
+{
+    struct mix_stream *s = mix_lock(a0);
+
+    if (!s)
+        return relay_waveOutSetVolume(a0, a1);
+
+    s->volume = a1;
+    LeaveCriticalSection(&mix_cs);
+    return MMSYSERR_NOERROR;
+}
+
+MMRESULT WINAPI fake_waveOutGetPitch(HWAVEOUT a0, PDWORD a1)
+{
+    return mix_known(a0) ? MMSYSERR_NOTSUPPORTED : relay_waveOutGetPitch(a0, a1);
+}
+
+MMRESULT WINAPI fake_waveOutSetPitch(HWAVEOUT a0, DWORD a1)
+{
+    return mix_known(a0) ? MMSYSERR_NOTSUPPORTED : relay_waveOutSetPitch(a0, a1);
+}
+
+MMRESULT WINAPI fake_waveOutGetPlaybackRate(HWAVEOUT a0, PDWORD a1)
+{
+    return mix_known(a0) ? MMSYSERR_NOTSUPPORTED : relay_waveOutGetPlaybackRate(a0, a1);
+}
+
+MMRESULT WINAPI fake_waveOutSetPlaybackRate(HWAVEOUT a0, DWORD a1)
+{
+    return mix_known(a0) ? MMSYSERR_NOTSUPPORTED : relay_waveOutSetPlaybackRate(a0, a1);
+}
+
+MMRESULT WINAPI fake_waveOutGetID(HWAVEOUT a0, LPUINT a1)
+{
+    if (!mix_known(a0))
+        return relay_waveOutGetID(a0, a1);
+
+    if (!a1)
+        return MMSYSERR_INVALPARAM;
+
+    *a1 = WAVE_MAPPER;
+    return MMSYSERR_NOERROR;
+}
+
+MMRESULT WINAPI fake_waveOutMessage(HWAVEOUT a0, UINT a1, DWORD a2, DWORD a3)
+{
+    return mix_known(a0) ? MMSYSERR_NOTSUPPORTED : relay_waveOutMessage(a0, a1, a2, a3);
+}
@@ -0,0 +1,3 @@
+/* Software mixer for the waveOut streams (mixer.c) */
+
+void mixer_enable(int rate);
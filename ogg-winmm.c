@@ -22,10 +22,19 @@
 #include <ctype.h>
 #include <dirent.h>
 #include "player.h"
-
-/* MCI Relay declarations: */
+#include "trace.h"
+#include "pak.h"
+#include "timer.h"
+#include "sound.h"
+#include "mixer.h"
+#include "midi.h"
+
+/* MCI Relay declarations (thunks generated into relay.s): */
 MCIERROR WINAPI relay_mciSendCommandA(MCIDEVICEID a0, UINT a1, DWORD a2, DWORD a3);
 MCIERROR WINAPI relay_mciSendStringA(LPCSTR a0, LPSTR a1, UINT a2, HWND a3);
+MCIERROR WINAPI relay_mciSendCommandW(MCIDEVICEID a0, UINT a1, DWORD a2, DWORD a3);
+MCIERROR WINAPI relay_mciSendStringW(LPCWSTR a0, LPWSTR a1, UINT a2, HWND a3);
+void relay_resolve_all(FILE *log);
 
 int MAGIC_DEVICEID = 48879; /* 48879 = 0xBEEF */
 #define MAX_TRACKS 99
@@ -37,6 +46,8 @@ struct track_info
     char path[MAX_PATH];    /* full path to ogg */
     unsigned int length;    /* seconds */
     unsigned int position;  /* seconds */
+    unsigned int start;     /* CD frames inside the file (CUE sheets) */
+    unsigned int end;
 };
 
 static struct track_info tracks[MAX_TRACKS];
@@ -54,6 +65,8 @@ int FullNotify = 0;
 int opened = 0;
 int sendStringNotify = 0;
 int ACCSeekOFF = 0;
+int Preload = 0;
+int ProbeTracks = 0; /* WarmStart and LoopTags need to open packed tracks too */
 int seek = 0;
 int plrpos = 0;
 int plrpos2 = -1;
@@ -62,6 +75,8 @@ int paused = 0;
 int notify = 0;
 int playing = 0;
 HANDLE player = NULL;
+volatile int pumping = 0; /* the player thread may still use the player, see player_stop() */
+HANDLE play_done = NULL; /* set while nothing plays, for MCI_WAIT */
 HANDLE initialize = NULL;
 HINSTANCE hModule = 0;
 
@@ -69,11 +84,192 @@ int firstTrack = -1;
 int lastTrack = 0;
 int numTracks = 1; /* +1 for data track on mixed mode cd's */
 char music_path[2048];
-int time_format = MCI_FORMAT_MSF;
-char alias_s[100] = "cdaudio";
+int MCIDevID = 0;
 static struct play_info info = { -1, -1 };
 
-int player_main(struct play_info *info)
+/* Open instances of the emulated drive. The game, a launcher or a second
+   alias each get their own device ID, alias, time format and notify window,
+   the player behind them is shared. devices[0] is cdaudio itself, it is
+   always there for commands sent without opening the drive first. */
+#define MAX_DEVICES     8
+#define DEVICE_SLOTS    16  /* power of two, lookup slots for IDs and aliases */
+
+struct mci_device
+{
+    MCIDEVICEID id;         /* 0 when not open */
+    char alias[100];        /* lower case */
+    DWORD alias_hash;
+    int time_format;
+    HWND notify_hwnd;       /* callback window of MCI_NOTIFY, NULL broadcasts */
+    int reserved_id;        /* id is held by a waveaudio device (MCIDevID) */
+};
+
+static struct mci_device devices[MAX_DEVICES] = { { 48879, "cdaudio", 0, MCI_FORMAT_MSF } };
+static struct mci_device *id_slots[DEVICE_SLOTS];
+static struct mci_device *alias_slots[DEVICE_SLOTS];
+static int device_slots_dirty = 1;
+
+static struct mci_device *dev = &devices[0];        /* of the command being handled */
+static struct mci_device *play_dev = &devices[0];   /* notified at the end of the play */
+
+static DWORD mci_alias_hash(const char *alias)
+{
+    DWORD h = 2166136261u;
+
+    while (*alias)
+        h = (h ^ (unsigned char)*alias++) * 16777619u;
+
+    return h;
+}
+
+/* the slots are rebuilt on the first lookup after an open or close */
+static void mci_device_slots()
+{
+    unsigned int i, j;
+
+    memset(id_slots, 0, sizeof id_slots);
+    memset(alias_slots, 0, sizeof alias_slots);
+
+    for (i = 0; i < MAX_DEVICES; i++)
+    {
+        struct mci_device *d = &devices[i];
+
+        if (!d->id)
+            continue;
+
+        d->alias_hash = mci_alias_hash(d->alias);
+
+        for (j = d->id; id_slots[j & (DEVICE_SLOTS - 1)]; j++);
+        id_slots[j & (DEVICE_SLOTS - 1)] = d;
+
+        for (j = d->alias_hash; alias_slots[j & (DEVICE_SLOTS - 1)]; j++);
+        alias_slots[j & (DEVICE_SLOTS - 1)] = d;
+    }
+
+    device_slots_dirty = 0;
+}
+
+static struct mci_device *mci_device_by_id(MCIDEVICEID id)
+{
+    unsigned int i;
+
+    if (device_slots_dirty)
+        mci_device_slots();
+
+    /* cdaudio answers for the commands to no device and to all of them */
+    if (id == 0 || id == MCI_ALL_DEVICE_ID)
+        return &devices[0];
+
+    for (i = id; id_slots[i & (DEVICE_SLOTS - 1)]; i++)
+    {
+        if (id_slots[i & (DEVICE_SLOTS - 1)]->id == id)
+            return id_slots[i & (DEVICE_SLOTS - 1)];
+    }
+
+    return NULL;
+}
+
+static struct mci_device *mci_device_by_alias(const char *alias)
+{
+    DWORD hash = mci_alias_hash(alias), i;
+
+    if (device_slots_dirty)
+        mci_device_slots();
+
+    for (i = hash; alias_slots[i & (DEVICE_SLOTS - 1)]; i++)
+    {
+        struct mci_device *d = alias_slots[i & (DEVICE_SLOTS - 1)];
+
+        if (d->alias_hash == hash && strcmp(d->alias, alias) == 0)
+            return d;
+    }
+
+    return NULL;
+}
+
+/* Opening an alias that is open already gives the same device, NULL when
+   there is no room for another one. */
+static struct mci_device *mci_device_open(const char *alias)
+{
+    struct mci_device *d;
+    int i;
+
+    if (!alias || !*alias)
+        return &devices[0];
+
+    if ((d = mci_device_by_alias(alias)) != NULL)
+        return d;
+
+    for (i = 1; i < MAX_DEVICES && devices[i].id; i++);
+
+    if (i == MAX_DEVICES)
+        return NULL;
+
+    d = &devices[i];
+    memset(d, 0, sizeof *d);
+    snprintf(d->alias, sizeof d->alias, "%s", alias);
+    d->time_format = MCI_FORMAT_MSF;
+    d->id = MAGIC_DEVICEID + i;
+
+    /* keep the id from clashing with the devices the game opens later */
+    if (MCIDevID)
+    {
+        MCI_OPEN_PARMS parms = { 0 };
+        char reserve[16];
+
+        snprintf(reserve, sizeof reserve, "ogg-winmm%d", i);
+        parms.lpstrDeviceType = "waveaudio";
+        parms.lpstrAlias = reserve;
+
+        if (relay_mciSendCommandA(0, MCI_OPEN, MCI_OPEN_TYPE|MCI_OPEN_ALIAS, (DWORD)&parms) == 0)
+        {
+            d->id = parms.wDeviceID;
+            d->reserved_id = 1;
+        }
+    }
+
+    device_slots_dirty = 1;
+    dprintf("  Opened device %d with alias %s\r\n", d->id, d->alias);
+
+    return d;
+}
+
+/* cdaudio itself stays open with its settings reset */
+static void mci_device_close(struct mci_device *d)
+{
+    d->time_format = MCI_FORMAT_MSF;
+    d->notify_hwnd = NULL;
+
+    if (d == &devices[0])
+        return;
+
+    dprintf("  Closed device %d with alias %s\r\n", d->id, d->alias);
+
+    if (play_dev == d)
+    {
+        notify = 0;
+        play_dev = &devices[0];
+    }
+
+    if (d->reserved_id)
+        relay_mciSendCommandA(d->id, MCI_CLOSE, 0, 0);
+
+    if (dev == d)
+        dev = &devices[0];
+
+    d->id = 0;
+    device_slots_dirty = 1;
+}
+
+void mci_notify(struct mci_device *d, WPARAM status)
+{
+    if (trace_enabled) trace_notify(status, d->id);
+    SendMessageA(d->notify_hwnd ? d->notify_hwnd : (HWND)0xffff, MM_MCINOTIFY, status, d->id);
+}
+
+LONGLONG play_requested = 0; /* when MCI_PLAY started the player, until its first sample was queued */
+
+static int player_play(struct play_info *info)
 {
     int first = info->first;
     int last = info->last -1; /* -1 for plr logic */
@@ -85,7 +281,9 @@ int player_main(struct play_info *info)
     while (current <= last && playing)
     {
         dprintf("Current track: %s\r\n", tracks[current].path);
-        plr_play(tracks[current].path);
+        plr_play_range(tracks[current].path, tracks[current].start, tracks[current].end);
+        plr_loop(current == last && plrpos2 == -1 && !tracks[current].end); /* loop tags only apply to single track plays */
+        plr_prefetch(current < last ? tracks[current+1].path : NULL);
 
         while (1)
         {
@@ -101,33 +299,42 @@ int player_main(struct play_info *info)
                 plrpos2 = -1;
                 paused = 1;
                 playing = 0;
+                pumping = 0;
                 if(notify){
                     notify = 0;
-                    dprintf("  Sending MCI_NOTIFY_SUCCESSFUL message...\r\n");
-                    SendMessageA((HWND)0xffff, MM_MCINOTIFY, MCI_NOTIFY_SUCCESSFUL, MAGIC_DEVICEID);
+                    dprintf("  Sending MCI_NOTIFY_SUCCESSFUL message... (%u ms)\r\n", plr_time());
+                    mci_notify(play_dev, MCI_NOTIFY_SUCCESSFUL);
                 }
                 return 0;
             }
 
-            if (plr_pump() == 0)
-                break;
+            int more = plr_pump();
 
             if (!playing)
             {
                 return 0;
             }
+
+            if (!more)
+                break;
+
+            if(play_requested && plr_written_us >= play_requested){
+                dprintf("  First sample queued %d us after MCI_PLAY\r\n", (int)(plr_written_us - play_requested));
+                play_requested = 0;
+            }
         }
         current++;
     }
 
     playing = 0;
+    pumping = 0;
 
     /* Sending notify successful message:*/
     if(notify && !paused)
     {
         notify = 0;
-        dprintf("  Sending MCI_NOTIFY_SUCCESSFUL message...\r\n");
-        SendMessageA((HWND)0xffff, MM_MCINOTIFY, MCI_NOTIFY_SUCCESSFUL, MAGIC_DEVICEID);
+        dprintf("  Sending MCI_NOTIFY_SUCCESSFUL message... (%u ms)\r\n", plr_time());
+        mci_notify(play_dev, MCI_NOTIFY_SUCCESSFUL);
         /* NOTE: Notify message after successful playback is not working in Vista+.
         MCI_STATUS_MODE does not update to show that the track is no longer playing.
         Bug or broken design in mcicda.dll (also noted by the Wine team) */
@@ -135,6 +342,41 @@ int player_main(struct play_info *info)
     return 0;
 }
 
+int player_main(struct play_info *info)
+{
+    player_play(info);
+    pumping = 0;
+    SetEvent(play_done);
+    return 0;
+}
+
+/* Stops the player thread where it next waits and waits for it to end, so
+   the player and the readers it may be blocked on can be closed after.
+   The thread sends its notify only after it stopped pumping, a notify
+   handler that plays or stops the CD does not wait for it then. */
+static void player_stop()
+{
+    MSG msg;
+
+    playing = 0;
+
+    if (!player || !pumping)
+        return;
+
+    plr_interrupt(1);
+
+    /* the thread may be sending a notify to a window of this thread */
+    while (MsgWaitForMultipleObjects(1, &player, FALSE, INFINITE, QS_SENDMESSAGE) == WAIT_OBJECT_0 + 1)
+        PeekMessage(&msg, NULL, 0, 0, PM_NOREMOVE);
+
+    plr_interrupt(0);
+}
+
+void scan_tracks(void);
+int scan_pak(void);
+int scan_cue(void);
+void preload_tracks(void);
+
 //Initialization thread:
 int initialize_main(void)
 {
@@ -142,6 +384,27 @@ int initialize_main(void)
     int bLog = GetPrivateProfileInt("winmm", "Log", 0, ".\\winmm.ini");
     if(bLog)fh = fopen("winmm.log", "w"); // Renamed to .log
 
+    //Point the forwarded winmm functions at the real dll before anything else, logging the missing ones:
+    relay_resolve_all(fh);
+
+    int iNativeTimer = GetPrivateProfileInt("winmm", "NativeTimer", 0, ".\\winmm.ini");
+    if(iNativeTimer){
+        iNativeTimer = timer_native(iNativeTimer);
+        if(iNativeTimer != TIMER_RELAY) dprintf("timeGetTime answered natively from the %s.\r\n", iNativeTimer == TIMER_INTERRUPT ? "interrupt time" : "performance counter");
+    }
+
+    int iTimerPeriod = GetPrivateProfileInt("winmm", "TimerPeriod", 0, ".\\winmm.ini");
+    if(iTimerPeriod > 0){
+        timer_hold_period(iTimerPeriod);
+        dprintf("Holding a %d ms timer resolution.\r\n", iTimerPeriod);
+    }
+
+    int iSoundCache = GetPrivateProfileInt("winmm", "SoundCacheKB", 0, ".\\winmm.ini");
+    if(iSoundCache > 0){
+        sound_cache(iSoundCache);
+        dprintf("Caching up to %d KB of PlaySound effects.\r\n", iSoundCache);
+    }
+
     int bMCIDevID = GetPrivateProfileInt("winmm", "MCIDevID", 0, ".\\winmm.ini");
     if(bMCIDevID){
         mciOpenParms.lpstrDeviceType = "waveaudio";
@@ -155,7 +418,10 @@ int initialize_main(void)
         else{
             MAGIC_DEVICEID = mciOpenParms.wDeviceID;
             dprintf("Wave device opened succesfully using cdaudio ID %d for emulation.\r\n",MAGIC_DEVICEID);
+            MCIDevID = 1; // aliases opened later reserve their own
         }
+        devices[0].id = MAGIC_DEVICEID;
+        device_slots_dirty = 1;
     }
 
     int bACCSeekOFF = GetPrivateProfileInt("winmm", "ACCSeekOFF", 0, ".\\winmm.ini");
@@ -163,11 +429,79 @@ int initialize_main(void)
 
     int bFullNotify = GetPrivateProfileInt("winmm", "FullNotify", 0, ".\\winmm.ini");
     if(bFullNotify) FullNotify = 1;
+
+    int iCacheMB = GetPrivateProfileInt("winmm", "CacheMB", 0, ".\\winmm.ini");
+    int iCacheSeconds = GetPrivateProfileInt("winmm", "CacheSeconds", 0, ".\\winmm.ini");
+    if(iCacheMB > 0){
+        plr_cache_limit(iCacheMB, iCacheSeconds);
+        dprintf("Caching up to %d MB of decoded music.\r\n", iCacheMB);
+    }
+
+    int iWarmStart = GetPrivateProfileInt("winmm", "WarmStart", 0, ".\\winmm.ini");
+    if(iWarmStart > 0){
+        plr_warm_start(iWarmStart);
+        ProbeTracks = 1;
+        dprintf("Pre-decoding the first %d ms of every track.\r\n", iWarmStart);
+    }
+
+    int iReadAhead = GetPrivateProfileInt("winmm", "ReadAheadKB", 0, ".\\winmm.ini");
+    if(iReadAhead > 0){
+        plr_read_ahead(iReadAhead);
+        dprintf("Reading tracks %d KB ahead.\r\n", iReadAhead);
+    }
+
+    int iOutputRate = GetPrivateProfileInt("winmm", "OutputRate", 0, ".\\winmm.ini");
+    if(iOutputRate > 0){
+        plr_output_rate(iOutputRate);
+        dprintf("Resampling music to %d Hz stereo.\r\n", iOutputRate);
+    }
+
+    int iMixWaveOut = GetPrivateProfileInt("winmm", "MixWaveOut", 0, ".\\winmm.ini");
+    if(iMixWaveOut > 0){
+        mixer_enable(iMixWaveOut);
+        if(iOutputRate <= 0) plr_output_rate(iMixWaveOut); // music needs no conversion in the mixer
+        dprintf("Mixing all wave output at %d Hz on one device.\r\n", iMixWaveOut);
+    }
+
+    int iBufferProfile = GetPrivateProfileInt("winmm", "BufferProfile", 0, ".\\winmm.ini");
+    if(iBufferProfile > 0){
+        int iBufferMinMs = GetPrivateProfileInt("winmm", "BufferMinMs", 0, ".\\winmm.ini");
+        int iBufferMaxMs = GetPrivateProfileInt("winmm", "BufferMaxMs", 0, ".\\winmm.ini");
+        plr_buffering(iBufferProfile, iBufferMinMs, iBufferMaxMs);
+        dprintf("Music buffering profile %d.\r\n", iBufferProfile);
+    }
+
+    int iVolumeLatency = GetPrivateProfileInt("winmm", "VolumeLatencyMs", 0, ".\\winmm.ini");
+    if(iVolumeLatency > 0){
+        plr_volume_latency(iVolumeLatency);
+        dprintf("Music volume applied within %d ms.\r\n", iVolumeLatency);
+    }
+
+    int bMidiMusic = GetPrivateProfileInt("winmm", "MidiMusic", 0, ".\\winmm.ini");
+
+    int bPreload = GetPrivateProfileInt("winmm", "Preload", 0, ".\\winmm.ini");
+    if(bPreload) Preload = 1;
+
+    int bLoopTags = GetPrivateProfileInt("winmm", "LoopTags", 0, ".\\winmm.ini");
+    if(bLoopTags){
+        plr_use_loop_tags(1);
+        ProbeTracks = 1;
+    }
+
+    int bTrace = GetPrivateProfileInt("winmm", "Trace", 0, ".\\winmm.ini");
+    if(bTrace){
+        if(trace_open("winmm.trc")) dprintf("Recording MCI trace to winmm.trc\r\n");
+    }
+
+    int bVirtualClock = GetPrivateProfileInt("winmm", "VirtualClock", 0, ".\\winmm.ini");
+    if(bVirtualClock){
+        plr_virtual_clock(1);
+        dprintf("Virtual clock enabled, music is not sent to a wave device.\r\n");
+    }
     //End of read winmm.ini options...
     
     //Do the other stuff:
     GetModuleFileName(hModule, music_path, sizeof music_path);
-    memset(tracks, 0, sizeof tracks);
 
     char *last = strrchr(music_path, '\\');
     if (last)
@@ -176,15 +510,48 @@ int initialize_main(void)
     }
     strncat(music_path, "\\MUSIC", sizeof music_path - 1);
 
+    if(bMidiMusic){
+        char midi_path[MAX_PATH];
+        snprintf(midi_path, sizeof midi_path, "%s\\MIDI", music_path);
+        midi_enable(midi_path, fh);
+        dprintf("Replacing MIDI songs with the files in %s\r\n", midi_path);
+    }
+
+    scan_tracks();
+    return 0;
+}
+
+//Build the emulated CD TOC from the music directory:
+void scan_tracks(void)
+{
+    memset(tracks, 0, sizeof tracks);
+    firstTrack = -1;
+    lastTrack = 0;
+    numTracks = 1;
+
     dprintf("ogg-winmm music directory is %s\r\n", music_path);
+
+    if (scan_pak())
+        return;
+
+    if (scan_cue())
+    {
+        preload_tracks();
+        return;
+    }
+
     dprintf("ogg-winmm searching tracks...\r\n");
 
     unsigned int position = 0;
 
     for (int i = 1; i < MAX_TRACKS; i++) /* "Changed: int i = 0" to "1" we can skip track00.ogg" */
     {
-        snprintf(tracks[i].path, sizeof tracks[i].path, "%s\\Track%02d.ogg", music_path, i);
-        tracks[i].length = plr_length(tracks[i].path);
+        static const char *exts[] = { "ogg", "flac", "wav" };
+        for (int e = 0; e < 3 && tracks[i].length < 4; e++)
+        {
+            snprintf(tracks[i].path, sizeof tracks[i].path, "%s\\Track%02d.%s", music_path, i, exts[e]);
+            tracks[i].length = plr_length(tracks[i].path);
+        }
         tracks[i].position = position + 2; //2 second pre-gap
 
         if (tracks[i].length < 4)
@@ -208,7 +575,171 @@ int initialize_main(void)
     }
 
     dprintf("Emulating total of %d CD tracks.\r\n\r\n", numTracks);
-    return 0;
+    preload_tracks();
+}
+
+void preload_tracks(void)
+{
+    if(Preload){
+        const char *paths[MAX_TRACKS];
+        int num = 0;
+        for (int i = 1; i < MAX_TRACKS; i++)
+            if (tracks[i].path[0] && (num == 0 || strcmp(paths[num-1], tracks[i].path) != 0)) paths[num++] = tracks[i].path;
+
+        DWORD bytes = plr_preload(paths, num);
+        if(bytes){
+            dprintf("Preloaded %d tracks, %u KB of music in memory.\r\n\r\n", num, bytes / 1024);
+        }
+        else{
+            dprintf("Could not preload the tracks, reading them from disk.\r\n\r\n");
+        }
+    }
+}
+
+//Build the TOC from the first CUE sheet in the music directory. Every track
+//is a range of CD frames (1/75 s) of a single audio file, positions come from
+//the INDEX 01 entries plus the 2 second lead-in and any PREGAP silence.
+int scan_cue(void)
+{
+    char pattern[MAX_PATH], cue[MAX_PATH], name[MAX_PATH] = "", line[512], type[32];
+    WIN32_FIND_DATA fd;
+
+    snprintf(pattern, sizeof pattern, "%s\\*.cue", music_path);
+    HANDLE find = FindFirstFile(pattern, &fd);
+    if (find == INVALID_HANDLE_VALUE) return 0;
+    snprintf(cue, sizeof cue, "%s\\%s", music_path, fd.cFileName);
+    FindClose(find);
+
+    FILE *fp = fopen(cue, "r");
+    if (!fp) return 0;
+
+    unsigned int index0[MAX_TRACKS] = {0}, index1[MAX_TRACKS] = {0}, gap[MAX_TRACKS] = {0};
+    int has0[MAX_TRACKS] = {0}, has1[MAX_TRACKS] = {0}, audio[MAX_TRACKS] = {0};
+    int track = 0, files = 0, num, m, sec, f;
+    unsigned int pregap = 0;
+
+    while (fgets(line, sizeof line, fp))
+    {
+        if (sscanf(line, " FILE \"%259[^\"]\"", name) == 1 || sscanf(line, " FILE %259s", name) == 1)
+        {
+            files++;
+        }
+        else if (sscanf(line, " TRACK %d %31s", &num, type) == 2)
+        {
+            track = (num > 0 && num < MAX_TRACKS) ? num : 0;
+            if (track) audio[track] = strcmp(type, "AUDIO") == 0;
+        }
+        else if (sscanf(line, " PREGAP %d:%d:%d", &m, &sec, &f) == 3)
+        {
+            pregap += (m * 60 + sec) * 75 + f;
+        }
+        else if (track && sscanf(line, " INDEX %d %d:%d:%d", &num, &m, &sec, &f) == 4)
+        {
+            if (num == 0) { index0[track] = (m * 60 + sec) * 75 + f; has0[track] = 1; }
+            if (num == 1) { index1[track] = (m * 60 + sec) * 75 + f; has1[track] = 1; gap[track] = pregap; }
+        }
+    }
+    fclose(fp);
+
+    if (files != 1)
+    {
+        dprintf("%s: only CUE sheets with a single FILE are supported\r\n", cue);
+        return 0;
+    }
+
+    char path[MAX_PATH];
+    snprintf(path, sizeof path, "%s\\%s", music_path, name);
+
+    int seconds = plr_length(path);
+    if (seconds < 4)
+    {
+        dprintf("%s: could not open %s\r\n", cue, path);
+        return 0;
+    }
+
+    dprintf("ogg-winmm reading tracks from %s\r\n", cue);
+
+    int added = 0;
+    for (int i = 1; i < MAX_TRACKS; i++)
+    {
+        if (!has1[i] || !audio[i]) continue;
+
+        unsigned int end = (seconds + 1) * 75; /* the player stops at the end of the file */
+        for (int j = i + 1; j < MAX_TRACKS; j++)
+        {
+            if (has1[j])
+            {
+                end = has0[j] ? index0[j] : index1[j];
+                break;
+            }
+        }
+
+        if (end <= index1[i] + 4 * 75) continue;
+
+        snprintf(tracks[i].path, sizeof tracks[i].path, "%s", path);
+        tracks[i].start = index1[i];
+        tracks[i].end = end;
+        tracks[i].length = (end - index1[i]) / 75;
+        if (tracks[i].length > seconds - index1[i] / 75) tracks[i].length = seconds - index1[i] / 75;
+        tracks[i].position = (index1[i] + gap[i] + 150) / 75;
+
+        if (firstTrack == -1)
+        {
+            firstTrack = i;
+        }
+        if(i == numTracks) numTracks -= 1; /* Take into account pure music cd's starting with track01.ogg */
+
+        dprintf("Track %02d: %02d:%02d @ %d seconds (frames %u-%u)\r\n", i, tracks[i].length / 60, tracks[i].length % 60, tracks[i].position, tracks[i].start, tracks[i].end);
+        numTracks++;
+        lastTrack = i;
+        added++;
+    }
+
+    if (!added)
+    {
+        dprintf("%s: no audio track could be used\r\n", cue);
+        return 0;
+    }
+
+    dprintf("Emulating total of %d CD tracks.\r\n\r\n", numTracks);
+    return 1;
+}
+
+//Build the TOC from MUSIC\music.pak (tools/oggpack.c) without opening the tracks:
+int scan_pak(void)
+{
+    char pak[MAX_PATH];
+    snprintf(pak, sizeof pak, "%s\\music.pak", music_path);
+
+    const struct pak_header *hdr = plr_pak(pak, music_path);
+    if (!hdr) return 0;
+
+    const struct pak_track *toc = (const struct pak_track *)(hdr + 1);
+    dprintf("ogg-winmm reading tracks from %s\r\n", pak);
+
+    for (DWORD n = 0; n < hdr->num_tracks; n++)
+    {
+        int i = toc[n].number;
+        if (i < 1 || i >= MAX_TRACKS || toc[n].length < 4) continue;
+
+        snprintf(tracks[i].path, sizeof tracks[i].path, "%s\\Track%02d.ogg", music_path, i);
+        tracks[i].length = toc[n].rate ? (unsigned int)(toc[n].samples / toc[n].rate) : toc[n].length; /* as plr_length() */
+        tracks[i].position = toc[n].position;
+        if (ProbeTracks) plr_length(tracks[i].path);
+
+        if (firstTrack == -1)
+        {
+            firstTrack = i;
+        }
+        if(i == numTracks) numTracks -= 1; /* Take into account pure music cd's starting with track01.ogg */
+
+        dprintf("Track %02d: %02d:%02d @ %d seconds\r\n", i, tracks[i].length / 60, tracks[i].length % 60, tracks[i].position);
+        numTracks++;
+        lastTrack = i;
+    }
+
+    dprintf("Emulating total of %d CD tracks.\r\n\r\n", numTracks);
+    return 1;
 }
 
 // The less done inside DllMain the better...
@@ -217,11 +748,13 @@ BOOL WINAPI DllMain(HINSTANCE hinstDLL, DWORD fdwReason, LPVOID lpvReserved)
 {
     if (fdwReason == DLL_PROCESS_ATTACH){
         hModule = hinstDLL;
+        play_done = CreateEvent(NULL, TRUE, TRUE, NULL);
         //Moved initialization stuff to its own thread to avoid issues...
         initialize = CreateThread(NULL, 0, (LPTHREAD_START_ROUTINE)initialize_main, NULL, 0, NULL);
     }
 
     if (fdwReason == DLL_PROCESS_DETACH){
+        trace_close();
         if (fh)
         {
             fclose(fh);
@@ -232,24 +765,172 @@ BOOL WINAPI DllMain(HINSTANCE hinstDLL, DWORD fdwReason, LPVOID lpvReserved)
     return TRUE;
 }
 
+/* Virtual clock harness (VirtualClock = 1 in winmm.ini) */
+/* Lets the emulated CD play until the virtual clock reaches ms and returns the clock. */
+/* With ms = INFINITE it returns as soon as playback stops. */
+DWORD WINAPI ogg_vclock_run(DWORD ms)
+{
+    WaitForSingleObject(initialize, INFINITE);
+
+    plr_vlimit(ms);
+
+    while (playing && player && plr_time() < ms)
+    {
+        HANDLE wait[2] = { plr_vblock, player };
+        if (WaitForMultipleObjects(2, wait, FALSE, INFINITE) != WAIT_OBJECT_0)
+            break;
+    }
+
+    if (!playing && ms != INFINITE)
+        plr_vidle(ms);
+
+    return plr_time();
+}
+
+/* Offline rendering (tools/oggrender.c) */
+/* Switches to the virtual clock, reads the tracks from music and captures the output to wav. */
+/* Call with wav = NULL to finish the file. */
+BOOL WINAPI ogg_render(const char *music, const char *wav)
+{
+    WaitForSingleObject(initialize, INFINITE);
+
+    if (!wav)
+    {
+        plr_capture_close();
+        return TRUE;
+    }
+
+    plr_virtual_clock(1);
+
+    if (!plr_capture(wav))
+        return FALSE;
+
+    if (music)
+    {
+        snprintf(music_path, sizeof music_path, "%s", music);
+        scan_tracks();
+    }
+
+    return TRUE;
+}
+
+/* The W entry points share the emulation of the A ones. Everything the
+   emulation understands is ASCII: their strings are narrowed (and lowered)
+   in a single pass into the buffers the A parsing uses anyway, what is not
+   emulated goes to the system W function untouched. */
+static void mci_narrow(char *dst, size_t size, LPCWSTR src, BOOL lower)
+{
+    size_t i;
+
+    for (i = 0; src[i] && i < size - 1; i++)
+    {
+        if (src[i] >= 0x80)
+            dst[i] = '?';
+        else
+            dst[i] = lower ? tolower(src[i]) : (char)src[i];
+    }
+
+    dst[i] = '\0';
+}
+
+static void mci_widen(LPWSTR dst, size_t size, const char *src)
+{
+    size_t i;
+
+    if (!dst || !size)
+        return;
+
+    for (i = 0; src[i] && i < size - 1; i++)
+        dst[i] = (unsigned char)src[i];
+
+    dst[i] = 0;
+}
+
+/* fills the lpstrReturn of an A or W parameter struct, truncated to size
+   characters like the driver does when it does not fit */
+static MCIERROR mci_return(LPVOID dst, DWORD size, const char *src, BOOL unicode)
+{
+    size_t len = strlen(src);
+
+    if (!dst || !size)
+        return MCIERR_PARAM_OVERFLOW;
+
+    if (unicode)
+    {
+        mci_widen(dst, size, src);
+    }
+    else
+    {
+        size_t n = len < size - 1 ? len : size - 1;
+        memcpy(dst, src, n);
+        ((char *)dst)[n] = 0;
+    }
+
+    dprintf("        Return: %s\r\n", src);
+    return len < size ? 0 : MCIERR_PARAM_OVERFLOW;
+}
+
+static MCIERROR relay_mciSendCommand(MCIDEVICEID IDDevice, UINT uMsg, DWORD_PTR fdwCommand, DWORD_PTR dwParam, BOOL unicode)
+{
+    if (unicode)
+        return relay_mciSendCommandW(IDDevice, uMsg, fdwCommand, dwParam);
+
+    return relay_mciSendCommandA(IDDevice, uMsg, fdwCommand, dwParam);
+}
+
+/* MCI_WAIT: blocks until the play ends or another thread stops it, the
+   player sets play_done right after the last buffer is done. Like with the
+   driver the wait can be broken with Ctrl+Break, the play goes on then.
+   Messages sent to the caller's windows (notifications among them) are
+   still delivered, the thread only wakes up for those and for key input. */
+static void mci_wait()
+{
+    MSG msg;
+
+    while (MsgWaitForMultipleObjects(1, &play_done, FALSE, INFINITE, QS_SENDMESSAGE|QS_KEY) == WAIT_OBJECT_0 + 1)
+    {
+        /* delivers the sent messages, the key input stays queued */
+        PeekMessage(&msg, NULL, WM_KEYFIRST, WM_KEYLAST, PM_NOREMOVE);
+
+        if (GetAsyncKeyState(VK_CANCEL) & 0x8000)
+        {
+            dprintf("  MCI_WAIT broken\r\n");
+            break;
+        }
+    }
+}
+
 /* MCI commands */
 /* https://docs.microsoft.com/windows/win32/multimedia/multimedia-commands */
-MCIERROR WINAPI fake_mciSendCommandA(MCIDEVICEID IDDevice, UINT uMsg, DWORD_PTR fdwCommand, DWORD_PTR dwParam)
+static MCIERROR emu_mciSendCommand(MCIDEVICEID IDDevice, UINT uMsg, DWORD_PTR fdwCommand, DWORD_PTR dwParam, BOOL unicode)
 {
     char cmdbuf[1024];
 
-    dprintf("mciSendCommandA(IDDevice=%p, uMsg=%p, fdwCommand=%p, dwParam=%p)\r\n", IDDevice, uMsg, fdwCommand, dwParam);
+    dprintf("mciSendCommand%c(IDDevice=%p, uMsg=%p, fdwCommand=%p, dwParam=%p)\r\n", unicode ? 'W' : 'A', IDDevice, uMsg, fdwCommand, dwParam);
 
     if (uMsg == MCI_OPEN)
     {
         LPMCI_OPEN_PARMS parms = (LPVOID)dwParam;
+        char alias[100] = "";
 
         dprintf("  MCI_OPEN\r\n");
 
         if (fdwCommand & MCI_OPEN_ALIAS)
         {
             dprintf("    MCI_OPEN_ALIAS\r\n");
-            dprintf("        -> %s\r\n", parms->lpstrAlias);
+            if (unicode)
+            {
+                mci_narrow(alias, sizeof alias, (LPCWSTR)parms->lpstrAlias, TRUE);
+            }
+            else
+            {
+                snprintf(alias, sizeof alias, "%s", parms->lpstrAlias);
+                for (int i = 0; alias[i]; i++)
+                {
+                    alias[i] = tolower(alias[i]);
+                }
+            }
+            dprintf("        -> %s\r\n", alias);
         }
 
         if (fdwCommand & MCI_OPEN_SHAREABLE)
@@ -263,60 +944,80 @@ MCIERROR WINAPI fake_mciSendCommandA(MCIDEVICEID IDDevice, UINT uMsg, DWORD_PTR
 
             if (LOWORD(parms->lpstrDeviceType) == MCI_DEVTYPE_CD_AUDIO)
             {
-                dprintf("  Returning magic device id %d for MCI_DEVTYPE_CD_AUDIO\r\n", MAGIC_DEVICEID);
-                parms->wDeviceID = MAGIC_DEVICEID;
+                struct mci_device *d = mci_device_open(alias);
+                if (!d) return MCIERR_OUT_OF_MEMORY;
+                dev = d;
+                if (fdwCommand & MCI_NOTIFY) dev->notify_hwnd = (HWND)parms->dwCallback;
+                dprintf("  Returning magic device id %d for MCI_DEVTYPE_CD_AUDIO\r\n", dev->id);
+                parms->wDeviceID = dev->id;
                 if (fdwCommand & MCI_NOTIFY)
                 {
                     if (FullNotify && !opened){
                         dprintf("  MCI_NOTIFY\r\n");
                         dprintf("  Sending MCI_NOTIFY_SUCCESSFUL message...\r\n");
-                        SendMessageA((HWND)0xffff, MM_MCINOTIFY, MCI_NOTIFY_SUCCESSFUL, MAGIC_DEVICEID);
-                        Sleep(50);
+                        mci_notify(dev, MCI_NOTIFY_SUCCESSFUL);
+                        plr_sleep(50);
                     }
                 }
                 opened = 1;
                 return 0;
             }
-            else return relay_mciSendCommandA(IDDevice, uMsg, fdwCommand, dwParam); /* Added MCI relay */
+            else return relay_mciSendCommand(IDDevice, uMsg, fdwCommand, dwParam, unicode); /* Added MCI relay */
         }
 
         if (fdwCommand & MCI_OPEN_TYPE && !(fdwCommand & MCI_OPEN_TYPE_ID))
         {
             dprintf("    MCI_OPEN_TYPE\r\n");
-            dprintf("        -> %s\r\n", parms->lpstrDeviceType);
-
             /* copy alias to buffer */
             char cmpaliasbuf[1024];
-            strcpy (cmpaliasbuf,parms->lpstrDeviceType);
-            /* change cmpaliasbuf into lower case */
-            for (int i = 0; cmpaliasbuf[i]; i++)
+            if (unicode)
             {
-                cmpaliasbuf[i] = tolower(cmpaliasbuf[i]);
+                mci_narrow(cmpaliasbuf, sizeof cmpaliasbuf, (LPCWSTR)parms->lpstrDeviceType, TRUE);
             }
+            else
+            {
+                strcpy (cmpaliasbuf,parms->lpstrDeviceType);
+                /* change cmpaliasbuf into lower case */
+                for (int i = 0; cmpaliasbuf[i]; i++)
+                {
+                    cmpaliasbuf[i] = tolower(cmpaliasbuf[i]);
+                }
+            }
+            dprintf("        -> %s\r\n", cmpaliasbuf);
 
             if (strcmp(cmpaliasbuf, "cdaudio") == 0)
             {
-                dprintf("  Returning magic device id %d for MCI_DEVTYPE_CD_AUDIO\r\n", MAGIC_DEVICEID);
-                parms->wDeviceID = MAGIC_DEVICEID;
+                struct mci_device *d = mci_device_open(alias);
+                if (!d) return MCIERR_OUT_OF_MEMORY;
+                dev = d;
+                if (fdwCommand & MCI_NOTIFY) dev->notify_hwnd = (HWND)parms->dwCallback;
+                dprintf("  Returning magic device id %d for MCI_DEVTYPE_CD_AUDIO\r\n", dev->id);
+                parms->wDeviceID = dev->id;
                 if (fdwCommand & MCI_NOTIFY)
                 {
                     if (FullNotify && !opened){
                         dprintf("  MCI_NOTIFY\r\n");
                         dprintf("  Sending MCI_NOTIFY_SUCCESSFUL message...\r\n");
-                        SendMessageA((HWND)0xffff, MM_MCINOTIFY, MCI_NOTIFY_SUCCESSFUL, MAGIC_DEVICEID);
-                        Sleep(50);
+                        mci_notify(dev, MCI_NOTIFY_SUCCESSFUL);
+                        plr_sleep(50);
                     }
                 }
                 opened = 1;
                 return 0;
             }
-            else return relay_mciSendCommandA(IDDevice, uMsg, fdwCommand, dwParam); /* Added MCI relay */
+            else return relay_mciSendCommand(IDDevice, uMsg, fdwCommand, dwParam, unicode); /* Added MCI relay */
         }
 
     }
 
-    if (IDDevice == MAGIC_DEVICEID || IDDevice == 0 || IDDevice == 0xFFFFFFFF)
+    struct mci_device *d = mci_device_by_id(IDDevice);
+
+    if (d)
     {
+        dev = d;
+        if ((fdwCommand & MCI_NOTIFY) && dwParam)
+            dev->notify_hwnd = (HWND)((LPMCI_GENERIC_PARMS)dwParam)->dwCallback;
+
         if (fdwCommand & MCI_WAIT)
         {
             dprintf("  MCI_WAIT\r\n");
@@ -354,8 +1055,8 @@ MCIERROR WINAPI fake_mciSendCommandA(MCIDEVICEID IDDevice, UINT uMsg, DWORD_PTR
                     notify = 0;
                     dprintf("  Sending MCI_NOTIFY_SUCCESSFUL message...\r\n");
                     // Note that MCI_NOTIFY_SUPERSEDED would be sent before MCI_NOTIFY_SUCCESSFUL if track was playing, but this is not emulated.
-                    SendMessageA((HWND)0xffff, MM_MCINOTIFY, MCI_NOTIFY_SUCCESSFUL, MAGIC_DEVICEID);
-                    Sleep(50);
+                    mci_notify(dev, MCI_NOTIFY_SUCCESSFUL);
+                    plr_sleep(50);
                 }
             }
         }
@@ -370,7 +1071,7 @@ MCIERROR WINAPI fake_mciSendCommandA(MCIDEVICEID IDDevice, UINT uMsg, DWORD_PTR
             {
                 dprintf("    MCI_SET_TIME_FORMAT\r\n");
 
-                time_format = parms->dwTimeFormat;
+                dev->time_format = parms->dwTimeFormat;
 
                 if (parms->dwTimeFormat == MCI_FORMAT_BYTES)
                 {
@@ -431,8 +1132,8 @@ MCIERROR WINAPI fake_mciSendCommandA(MCIDEVICEID IDDevice, UINT uMsg, DWORD_PTR
                     notify = 0;
                     dprintf("  Sending MCI_NOTIFY_SUCCESSFUL message...\r\n");
                     // Note that MCI_NOTIFY_SUPERSEDED would be sent before MCI_NOTIFY_SUCCESSFUL if track was playing, but this is not emulated.
-                    SendMessageA((HWND)0xffff, MM_MCINOTIFY, MCI_NOTIFY_SUCCESSFUL, MAGIC_DEVICEID);
-                    Sleep(50);
+                    mci_notify(dev, MCI_NOTIFY_SUCCESSFUL);
+                    plr_sleep(50);
                 }
             }
         }
@@ -444,7 +1145,7 @@ MCIERROR WINAPI fake_mciSendCommandA(MCIDEVICEID IDDevice, UINT uMsg, DWORD_PTR
             if(notify){
                 notify = 0;
                 dprintf("  Sending MCI_NOTIFY_ABORTED message...\r\n");
-                SendMessageA((HWND)0xffff, MM_MCINOTIFY, MCI_NOTIFY_ABORTED, MAGIC_DEVICEID);
+                mci_notify(play_dev, MCI_NOTIFY_ABORTED);
             }
         
             LPMCI_SEEK_PARMS parms = (LPVOID)dwParam;
@@ -456,6 +1157,8 @@ MCIERROR WINAPI fake_mciSendCommandA(MCIDEVICEID IDDevice, UINT uMsg, DWORD_PTR
                 dprintf("    Seek to firstTrack %d\r\n",firstTrack);
                 current = info.first = firstTrack;
                 info.last = lastTrack;
+                player_stop();
+                midi_yield();
                 plr_stop();
                 playing = 0;
                 plrpos = 0;
@@ -466,6 +1169,8 @@ MCIERROR WINAPI fake_mciSendCommandA(MCIDEVICEID IDDevice, UINT uMsg, DWORD_PTR
             {
                 dprintf("    Seek to end of disc\r\n");
                 // Not very useful as a real disc can not play from this position
+                player_stop();
+                midi_yield();
                 plr_stop();
                 playing = 0;
                 plrpos = 0;
@@ -476,7 +1181,7 @@ MCIERROR WINAPI fake_mciSendCommandA(MCIDEVICEID IDDevice, UINT uMsg, DWORD_PTR
             {
                 dprintf("    dwTo:   %d\r\n", parms->dwTo);
 
-                if (time_format == MCI_FORMAT_TMSF)
+                if (dev->time_format == MCI_FORMAT_TMSF)
                 {
                     current = info.first = MCI_TMSF_TRACK(parms->dwTo);
                     info.last = lastTrack;
@@ -500,7 +1205,7 @@ MCIERROR WINAPI fake_mciSendCommandA(MCIDEVICEID IDDevice, UINT uMsg, DWORD_PTR
                         plrpos = 0;
                     }
                 }
-                else if (time_format == MCI_FORMAT_MILLISECONDS)
+                else if (dev->time_format == MCI_FORMAT_MILLISECONDS)
                 {
                     int target = (parms->dwTo / 1000)+1; //+1 needed for matching logic
                     int i = firstTrack;
@@ -572,7 +1277,9 @@ MCIERROR WINAPI fake_mciSendCommandA(MCIDEVICEID IDDevice, UINT uMsg, DWORD_PTR
                         plrpos = 0;
                     }
                 }
-                if(playing)plr_stop();
+                player_stop();
+                midi_yield();
+                plr_stop();
                 playing = 0;
             }
             if ((fdwCommand & MCI_NOTIFY) || sendStringNotify)
@@ -581,8 +1288,8 @@ MCIERROR WINAPI fake_mciSendCommandA(MCIDEVICEID IDDevice, UINT uMsg, DWORD_PTR
                 if (FullNotify && opened){
                     dprintf("  MCI_NOTIFY\r\n");
                     dprintf("  Sending MCI_NOTIFY_SUCCESSFUL message...\r\n");
-                    SendMessageA((HWND)0xffff, MM_MCINOTIFY, MCI_NOTIFY_SUCCESSFUL, MAGIC_DEVICEID);
-                    Sleep(50);
+                    mci_notify(dev, MCI_NOTIFY_SUCCESSFUL);
+                    plr_sleep(50);
                 }
             }
         }
@@ -590,18 +1297,18 @@ MCIERROR WINAPI fake_mciSendCommandA(MCIDEVICEID IDDevice, UINT uMsg, DWORD_PTR
         if (uMsg == MCI_CLOSE)
         {
             dprintf("  MCI_CLOSE\r\n");
-            time_format = MCI_FORMAT_MSF;
             if (fdwCommand & MCI_NOTIFY)
             {
                 if (FullNotify && opened){
                     notify = 0;
                     dprintf("  MCI_NOTIFY\r\n");
                     dprintf("  Sending MCI_NOTIFY_SUCCESSFUL message...\r\n");
-                    SendMessageA((HWND)0xffff, MM_MCINOTIFY, MCI_NOTIFY_SUCCESSFUL, MAGIC_DEVICEID);
-                    Sleep(50);
+                    mci_notify(dev, MCI_NOTIFY_SUCCESSFUL);
+                    plr_sleep(50);
                 }
             }
             opened = 0;
+            mci_device_close(dev);
             /* NOTE: MCI_CLOSE does stop the music in Vista+ but the original behaviour did not
                it only closed the handle to the opened device. You could still send MCI commands
                to a default cdaudio device but if you had used an alias you needed to re-open it.
@@ -613,7 +1320,7 @@ MCIERROR WINAPI fake_mciSendCommandA(MCIDEVICEID IDDevice, UINT uMsg, DWORD_PTR
             if(notify){
                 notify = 0;
                 dprintf("  Sending MCI_NOTIFY_ABORTED message...\r\n");
-                SendMessageA((HWND)0xffff, MM_MCINOTIFY, MCI_NOTIFY_ABORTED, MAGIC_DEVICEID);
+                mci_notify(play_dev, MCI_NOTIFY_ABORTED);
             }
 
             LPMCI_PLAY_PARMS parms = (LPVOID)dwParam;
@@ -630,6 +1337,7 @@ MCIERROR WINAPI fake_mciSendCommandA(MCIDEVICEID IDDevice, UINT uMsg, DWORD_PTR
             {
                 dprintf("  MCI_NOTIFY\r\n");
                 notify = 1; /* storing the notify request */
+                play_dev = dev;
                 sendStringNotify = 0;
             }
 
@@ -637,7 +1345,7 @@ MCIERROR WINAPI fake_mciSendCommandA(MCIDEVICEID IDDevice, UINT uMsg, DWORD_PTR
             {
                 dprintf("    dwFrom: %d\r\n", parms->dwFrom);
 
-                if (time_format == MCI_FORMAT_TMSF)
+                if (dev->time_format == MCI_FORMAT_TMSF)
                 {
                     info.first = MCI_TMSF_TRACK(parms->dwFrom);
 
@@ -656,7 +1364,7 @@ MCIERROR WINAPI fake_mciSendCommandA(MCIDEVICEID IDDevice, UINT uMsg, DWORD_PTR
                         dprintf("seek to plrpos %d\n",plrpos);
                     }
                 }
-                else if (time_format == MCI_FORMAT_MILLISECONDS)
+                else if (dev->time_format == MCI_FORMAT_MILLISECONDS)
                 {
                     info.first = 0;
                     
@@ -739,7 +1447,7 @@ MCIERROR WINAPI fake_mciSendCommandA(MCIDEVICEID IDDevice, UINT uMsg, DWORD_PTR
             {
                 dprintf("    dwTo:   %d\r\n", parms->dwTo);
 
-                if (time_format == MCI_FORMAT_TMSF)
+                if (dev->time_format == MCI_FORMAT_TMSF)
                 {
                     info.last = MCI_TMSF_TRACK(parms->dwTo);
 
@@ -758,7 +1466,7 @@ MCIERROR WINAPI fake_mciSendCommandA(MCIDEVICEID IDDevice, UINT uMsg, DWORD_PTR
                         dprintf("seek to plrpos2 %d\n",plrpos2);
                     }
                 }
-                else if (time_format == MCI_FORMAT_MILLISECONDS)
+                else if (dev->time_format == MCI_FORMAT_MILLISECONDS)
                 {
                     info.last = info.first;
 
@@ -840,11 +1548,28 @@ MCIERROR WINAPI fake_mciSendCommandA(MCIDEVICEID IDDevice, UINT uMsg, DWORD_PTR
             if(!ignore){
                 if (player)
                 {
-                    TerminateThread(player, 0);
+                    player_stop();
+                    CloseHandle(player);
+                    player = NULL;
+                    SetEvent(play_done); // releases a wait on the play it ended
                 }
 
+                midi_yield();
                 playing = 1;
+                pumping = 1;
+                play_requested = plr_us();
+                ResetEvent(play_done);
                 player = CreateThread(NULL, 100000, (LPTHREAD_START_ROUTINE)player_main, (void *)&info, 0, NULL);
+                if (!player){
+                    pumping = 0;
+                    SetEvent(play_done);
+                }
+            }
+
+            if (fdwCommand & MCI_WAIT)
+            {
+                dprintf("  Waiting for the play to end...\r\n");
+                mci_wait();
             }
 
         }
@@ -859,12 +1584,13 @@ MCIERROR WINAPI fake_mciSendCommandA(MCIDEVICEID IDDevice, UINT uMsg, DWORD_PTR
                 dprintf("stop/pause plrpos %d\n",plrpos);
                 paused = 1;
             }
-            playing = 0;
+            player_stop();
+            midi_yield(); // the MIDI replacement may be pumping the player, even with no CD track playing
             plr_stop();
             if(notify){
                 notify = 0;
                 dprintf("  Sending MCI_NOTIFY_ABORTED message...\r\n");
-                SendMessageA((HWND)0xffff, MM_MCINOTIFY, MCI_NOTIFY_ABORTED, MAGIC_DEVICEID);
+                mci_notify(play_dev, MCI_NOTIFY_ABORTED);
             }
             if ((fdwCommand & MCI_NOTIFY) || sendStringNotify)
             {
@@ -872,8 +1598,8 @@ MCIERROR WINAPI fake_mciSendCommandA(MCIDEVICEID IDDevice, UINT uMsg, DWORD_PTR
                 if (FullNotify && opened){
                     dprintf("  MCI_NOTIFY\r\n");
                     dprintf("  Sending MCI_NOTIFY_SUCCESSFUL message...\r\n");
-                    SendMessageA((HWND)0xffff, MM_MCINOTIFY, MCI_NOTIFY_SUCCESSFUL, MAGIC_DEVICEID);
-                    Sleep(50);
+                    mci_notify(dev, MCI_NOTIFY_SUCCESSFUL);
+                    plr_sleep(50);
                 }
             }
         }
@@ -882,20 +1608,20 @@ MCIERROR WINAPI fake_mciSendCommandA(MCIDEVICEID IDDevice, UINT uMsg, DWORD_PTR
         {
             dprintf("  MCI_INFO\n");
             LPMCI_INFO_PARMS parms = (LPVOID)dwParam;
+            MCIERROR err = 0;
 
             if(fdwCommand & MCI_INFO_PRODUCT)
             {
                 dprintf("    MCI_INFO_PRODUCT\n");
-                memcpy((LPVOID)(parms->lpstrReturn), (LPVOID)&"CD Audio", 9);
-                dprintf("        Return: %s\r\n", parms->lpstrReturn);
+                err = mci_return(parms->lpstrReturn, parms->dwRetSize, "CD Audio", unicode);
             }
 
             if(fdwCommand & MCI_INFO_MEDIA_IDENTITY)
             {
                 dprintf("    MCI_INFO_MEDIA_IDENTITY\n");
-                memcpy((LPVOID)(parms->lpstrReturn), (LPVOID)&"12345678", 9);
-                dprintf("        Return: %s\r\n", parms->lpstrReturn);
+                err = mci_return(parms->lpstrReturn, parms->dwRetSize, "12345678", unicode);
             }
+            if(err) return err;
             if (fdwCommand & MCI_NOTIFY)
             {
                 if (FullNotify && opened){
@@ -903,8 +1629,8 @@ MCIERROR WINAPI fake_mciSendCommandA(MCIDEVICEID IDDevice, UINT uMsg, DWORD_PTR
                     notify = 0;
                     dprintf("  Sending MCI_NOTIFY_SUCCESSFUL message...\r\n");
                     // Note that MCI_NOTIFY_SUPERSEDED would be sent before MCI_NOTIFY_SUCCESSFUL if track was playing, but this is not emulated.
-                    SendMessageA((HWND)0xffff, MM_MCINOTIFY, MCI_NOTIFY_SUCCESSFUL, MAGIC_DEVICEID);
-                    Sleep(50);
+                    mci_notify(dev, MCI_NOTIFY_SUCCESSFUL);
+                    plr_sleep(50);
                 }
             }
         }
@@ -918,19 +1644,19 @@ MCIERROR WINAPI fake_mciSendCommandA(MCIDEVICEID IDDevice, UINT uMsg, DWORD_PTR
             if(fdwCommand & MCI_SYSINFO_QUANTITY)
             {
                 dprintf("    MCI_SYSINFO_QUANTITY\r\n");
-                memcpy((LPVOID)(parms->lpstrReturn), (LPVOID)&"1", 2); /* quantity = 1 */
+                MCIERROR err = mci_return(parms->lpstrReturn, parms->dwRetSize, "1", unicode); /* quantity = 1 */
+                if(err) return err;
                 //parms->dwRetSize = sizeof(DWORD);
                 //parms->dwNumber = MAGIC_DEVICEID;
-                dprintf("        Return: %s\r\n", parms->lpstrReturn);
             }
 
             if(fdwCommand & MCI_SYSINFO_NAME || fdwCommand & MCI_SYSINFO_INSTALLNAME)
             {
                 dprintf("    MCI_SYSINFO_NAME\r\n");
-                memcpy((LPVOID)(parms->lpstrReturn), (LPVOID)&"cdaudio", 8); /* name = cdaudio */
+                MCIERROR err = mci_return(parms->lpstrReturn, parms->dwRetSize, "cdaudio", unicode); /* name = cdaudio */
+                if(err) return err;
                 //parms->dwRetSize = sizeof(DWORD);
                 //parms->dwNumber = MAGIC_DEVICEID;
-                dprintf("        Return: %s\r\n", parms->lpstrReturn);
             }
         }
 
@@ -966,7 +1692,7 @@ MCIERROR WINAPI fake_mciSendCommandA(MCIDEVICEID IDDevice, UINT uMsg, DWORD_PTR
                     if(fdwCommand & MCI_TRACK)
                     {
                         int seconds = tracks[parms->dwTrack].length;
-                        if (time_format == MCI_FORMAT_MILLISECONDS)
+                        if (dev->time_format == MCI_FORMAT_MILLISECONDS)
                         {
                             parms->dwReturn = seconds * 1000;
                         }
@@ -978,7 +1704,7 @@ MCIERROR WINAPI fake_mciSendCommandA(MCIDEVICEID IDDevice, UINT uMsg, DWORD_PTR
                     /* Get full length */
                     else
                     {
-                        if (time_format == MCI_FORMAT_MILLISECONDS)
+                        if (dev->time_format == MCI_FORMAT_MILLISECONDS)
                         {
                             parms->dwReturn = (tracks[lastTrack].position + tracks[lastTrack].length) * 1000;
                         }
@@ -1026,9 +1752,9 @@ MCIERROR WINAPI fake_mciSendCommandA(MCIDEVICEID IDDevice, UINT uMsg, DWORD_PTR
 
                     if (fdwCommand & MCI_TRACK)
                     {
-                        if (time_format == MCI_FORMAT_MILLISECONDS)
+                        if (dev->time_format == MCI_FORMAT_MILLISECONDS)
                             parms->dwReturn = tracks[parms->dwTrack].position * 1000;
-                        else if (time_format == MCI_FORMAT_MSF)
+                        else if (dev->time_format == MCI_FORMAT_MSF)
                             parms->dwReturn = MCI_MAKE_MSF(tracks[parms->dwTrack].position / 60, tracks[parms->dwTrack].position % 60, 0);
                         else //TMSF
                             parms->dwReturn = MCI_MAKE_TMSF(parms->dwTrack, 0, 0, 0);
@@ -1036,12 +1762,12 @@ MCIERROR WINAPI fake_mciSendCommandA(MCIDEVICEID IDDevice, UINT uMsg, DWORD_PTR
                     else {
                         /* Current position */
                         int track = current % 0xFF;
-                        if (time_format == MCI_FORMAT_MILLISECONDS){
+                        if (dev->time_format == MCI_FORMAT_MILLISECONDS){
                             if(!playing && !paused)parms->dwReturn = tracks[track].position * 1000;
                             else if(!playing && paused)parms->dwReturn = tracks[track].position * 1000 + plrpos * 1000;
                             else parms->dwReturn = tracks[track].position * 1000 + plr_tell() * 1000;
                         }
-                        else if (time_format == MCI_FORMAT_MSF){
+                        else if (dev->time_format == MCI_FORMAT_MSF){
                             if(!playing && !paused)parms->dwReturn = MCI_MAKE_MSF(tracks[track].position / 60, tracks[track].position % 60, 0);
                             else if(!playing && paused)parms->dwReturn = MCI_MAKE_MSF((tracks[track].position + plrpos) / 60, (tracks[track].position + plrpos) % 60, 0);
                             else parms->dwReturn = MCI_MAKE_MSF((tracks[track].position + plr_tell()) / 60, (tracks[track].position + plr_tell()) % 60, 0);
@@ -1079,15 +1805,15 @@ MCIERROR WINAPI fake_mciSendCommandA(MCIDEVICEID IDDevice, UINT uMsg, DWORD_PTR
                 if (parms->dwItem == MCI_STATUS_TIME_FORMAT)
                 {
                     dprintf("      MCI_STATUS_TIME_FORMAT\r\n");
-                    parms->dwReturn = time_format;
+                    parms->dwReturn = dev->time_format;
                 }
 
                 if (parms->dwItem == MCI_STATUS_START)
                 {
                     dprintf("      MCI_STATUS_START\r\n");
-                    if (time_format == MCI_FORMAT_MILLISECONDS)
+                    if (dev->time_format == MCI_FORMAT_MILLISECONDS)
                         parms->dwReturn = tracks[firstTrack].position * 1000;
-                    else if (time_format == MCI_FORMAT_MSF)
+                    else if (dev->time_format == MCI_FORMAT_MSF)
                         parms->dwReturn = MCI_MAKE_MSF(tracks[firstTrack].position / 60, tracks[parms->dwTrack].position % 60, 0);
                     else //TMSF
                         parms->dwReturn = MCI_MAKE_TMSF(1, 0, 0, 0);
@@ -1103,8 +1829,8 @@ MCIERROR WINAPI fake_mciSendCommandA(MCIDEVICEID IDDevice, UINT uMsg, DWORD_PTR
                     notify = 0;
                     dprintf("  Sending MCI_NOTIFY_SUCCESSFUL message...\r\n");
                     // Note that MCI_NOTIFY_SUPERSEDED would be sent before MCI_NOTIFY_SUCCESSFUL if track was playing, but this is not emulated.
-                    SendMessageA((HWND)0xffff, MM_MCINOTIFY, MCI_NOTIFY_SUCCESSFUL, MAGIC_DEVICEID);
-                    Sleep(50);
+                    mci_notify(dev, MCI_NOTIFY_SUCCESSFUL);
+                    plr_sleep(50);
                 }
             }
         }
@@ -1114,36 +1840,44 @@ MCIERROR WINAPI fake_mciSendCommandA(MCIDEVICEID IDDevice, UINT uMsg, DWORD_PTR
 
     /* fallback */
     //return MCIERR_UNRECOGNIZED_COMMAND;
-    else return relay_mciSendCommandA(IDDevice, uMsg, fdwCommand, dwParam); /* Added MCI relay */
+    else return relay_mciSendCommand(IDDevice, uMsg, fdwCommand, dwParam, unicode); /* Added MCI relay */
+}
+
+static MCIERROR emu_mciSendCommandA(MCIDEVICEID IDDevice, UINT uMsg, DWORD_PTR fdwCommand, DWORD_PTR dwParam)
+{
+    return emu_mciSendCommand(IDDevice, uMsg, fdwCommand, dwParam, FALSE);
 }
 
 /* MCI command strings */
 /* https://docs.microsoft.com/windows/win32/multimedia/multimedia-command-strings */
-MCIERROR WINAPI fake_mciSendStringA(LPCTSTR cmd, LPTSTR ret, UINT cchReturn, HANDLE hwndCallback)
+/* Takes the lower case command in cmdbuf, returns MCI_NOT_EMULATED for the
+   A or W caller to relay it. */
+#define MCI_NOT_EMULATED ((MCIERROR)-1)
+
+static MCIERROR emu_mciSendString(char *cmdbuf, LPSTR ret, UINT cchReturn, HANDLE hwndCallback)
 {
-    char cmdbuf[1024];
-    char cmp_str[1024];
+    char verb[16] = "", name[100] = "";
 
-    dprintf("[MCI String = %s]\n", cmd);
+    /* "verb device ...", the device is cdaudio or the alias of an open one */
+    sscanf(cmdbuf, "%15s %99s", verb, name);
+    struct mci_device *d = mci_device_by_alias(name);
 
-    /* copy cmd into cmdbuf */
-    strcpy (cmdbuf,cmd);
-    /* change cmdbuf into lower case */
-    for (int i = 0; cmdbuf[i]; i++)
+    if (d)
     {
-        cmdbuf[i] = tolower(cmdbuf[i]);
+        dev = d;
+        if (hwndCallback && strstr(cmdbuf, "notify"))
+            dev->notify_hwnd = (HWND)hwndCallback;
     }
 
     // handle info
-    sprintf(cmp_str, "info %s", alias_s);
-    if (strstr(cmdbuf, cmp_str))
+    if (d && strcmp(verb, "info") == 0)
     {
         if ((strstr(cmdbuf, "notify")) && FullNotify && opened){
             notify = 0;
             dprintf("  MCI_NOTIFY\r\n");
             dprintf("  Sending MCI_NOTIFY_SUCCESSFUL message...\r\n");
-            SendMessageA((HWND)0xffff, MM_MCINOTIFY, MCI_NOTIFY_SUCCESSFUL, MAGIC_DEVICEID);
-            Sleep(50);
+            mci_notify(dev, MCI_NOTIFY_SUCCESSFUL);
+            plr_sleep(50);
         }
         if (strstr(cmdbuf, "identity"))
         {
@@ -1161,15 +1895,14 @@ MCIERROR WINAPI fake_mciSendStringA(LPCTSTR cmd, LPTSTR ret, UINT cchReturn, HAN
     }
 
     // MCI_GETDEVCAPS SendString equivalent 
-    sprintf(cmp_str, "capability %s", alias_s);
-    if (strstr(cmdbuf, cmp_str))
+    if (d && strcmp(verb, "capability") == 0)
     {
         if ((strstr(cmdbuf, "notify")) && FullNotify && opened){
             notify = 0;
             dprintf("  MCI_NOTIFY\r\n");
             dprintf("  Sending MCI_NOTIFY_SUCCESSFUL message...\r\n");
-            SendMessageA((HWND)0xffff, MM_MCINOTIFY, MCI_NOTIFY_SUCCESSFUL, MAGIC_DEVICEID);
-            Sleep(50);
+            mci_notify(dev, MCI_NOTIFY_SUCCESSFUL);
+            plr_sleep(50);
         }
         if (strstr(cmdbuf, "device type")){
             strcpy(ret, "cdaudio");
@@ -1201,8 +1934,12 @@ MCIERROR WINAPI fake_mciSendStringA(LPCTSTR cmd, LPTSTR ret, UINT cchReturn, HAN
         if (strstr(cmdbuf, "name"))
         {
             if (strstr(cmdbuf, "open")){
-                dprintf("  Returning alias name: %s\r\n",alias_s);
-                sprintf(ret, "%s", alias_s);
+                /* the n-th open alias, cdaudio when there is none */
+                int n = 1, i;
+                sscanf(cmdbuf, "sysinfo cdaudio name %d", &n);
+                for (i = 1; i < MAX_DEVICES && (!devices[i].id || --n > 0); i++);
+                sprintf(ret, "%s", i < MAX_DEVICES ? devices[i].alias : "cdaudio");
+                dprintf("  Returning alias name: %s\r\n",ret);
                 return 0;
             }
         }
@@ -1215,24 +1952,22 @@ MCIERROR WINAPI fake_mciSendStringA(LPCTSTR cmd, LPTSTR ret, UINT cchReturn, HAN
     }
 
     /* Handle "stop cdaudio/alias" */
-    sprintf(cmp_str, "stop %s", alias_s);
-    if (strstr(cmdbuf, cmp_str))
+    if (d && strcmp(verb, "stop") == 0)
     {
         if (strstr(cmdbuf, "notify")){
             if(FullNotify && opened)sendStringNotify = 1; /* storing the notify request */
         }
-        fake_mciSendCommandA(MAGIC_DEVICEID, MCI_STOP, 0, (DWORD_PTR)NULL);
+        emu_mciSendCommandA(dev->id, MCI_STOP, 0, (DWORD_PTR)NULL);
         return 0;
     }
 
     /* Handle "pause cdaudio/alias" */
-    sprintf(cmp_str, "pause %s", alias_s);
-    if (strstr(cmdbuf, cmp_str))
+    if (d && strcmp(verb, "pause") == 0)
     {
         if (strstr(cmdbuf, "notify")){
             if(FullNotify && opened)sendStringNotify = 1; /* storing the notify request */
         }
-        fake_mciSendCommandA(MAGIC_DEVICEID, MCI_PAUSE, 0, (DWORD_PTR)NULL);
+        emu_mciSendCommandA(dev->id, MCI_PAUSE, 0, (DWORD_PTR)NULL);
         return 0;
     }
 
@@ -1268,19 +2003,20 @@ MCIERROR WINAPI fake_mciSendStringA(LPCTSTR cmd, LPTSTR ret, UINT cchReturn, HAN
 			}
 	        
             char *tmp_s = strrchr(cmdbuf, ' ');
-            if (tmp_s && *(tmp_s +1))
-            {
-                sprintf(alias_s, "%s", tmp_s +1);
-                dprintf("alias is: %s\n",alias_s);
-            }
+            if (!(d = mci_device_open(tmp_s ? tmp_s +1 : NULL)))
+                return MCIERR_OUT_OF_MEMORY;
+            dev = d;
+            if (hwndCallback && strstr(cmdbuf, "notify"))
+                dev->notify_hwnd = (HWND)hwndCallback;
+            dprintf("alias is: %s\n",dev->alias);
             //char devid_str[100];
             //sprintf(devid_str, "%d", MAGIC_DEVICEID);
             //if(cchReturn)strcpy(ret, devid_str); //Only fill the return buffer if it is expected (buffer size > 0)
             if ((strstr(cmdbuf, "notify")) && FullNotify && !opened){
                 dprintf("  MCI_NOTIFY\r\n");
                 dprintf("  Sending MCI_NOTIFY_SUCCESSFUL message...\r\n");
-                SendMessageA((HWND)0xffff, MM_MCINOTIFY, MCI_NOTIFY_SUCCESSFUL, MAGIC_DEVICEID);
-                Sleep(50);
+                mci_notify(dev, MCI_NOTIFY_SUCCESSFUL);
+                plr_sleep(50);
             }
             opened = 1;
             return 0;
@@ -1315,19 +2051,20 @@ MCIERROR WINAPI fake_mciSendStringA(LPCTSTR cmd, LPTSTR ret, UINT cchReturn, HAN
 			}
 	        
             char *tmp_s = strrchr(cmdbuf, ' ');
-            if (tmp_s && *(tmp_s +1))
-            {
-                sprintf(alias_s, "%s", tmp_s +1);
-                dprintf("alias is: %s\n",alias_s);
-            }
+            if (!(d = mci_device_open(tmp_s ? tmp_s +1 : NULL)))
+                return MCIERR_OUT_OF_MEMORY;
+            dev = d;
+            if (hwndCallback && strstr(cmdbuf, "notify"))
+                dev->notify_hwnd = (HWND)hwndCallback;
+            dprintf("alias is: %s\n",dev->alias);
             //char devid_str[100];
             //sprintf(devid_str, "%d", MAGIC_DEVICEID);
             //if(cchReturn)strcpy(ret, devid_str); //Only fill the return buffer if it is expected (buffer size > 0)
             if ((strstr(cmdbuf, "notify")) && FullNotify && !opened){
                 dprintf("  MCI_NOTIFY\r\n");
                 dprintf("  Sending MCI_NOTIFY_SUCCESSFUL message...\r\n");
-                SendMessageA((HWND)0xffff, MM_MCINOTIFY, MCI_NOTIFY_SUCCESSFUL, MAGIC_DEVICEID);
-                Sleep(50);
+                mci_notify(dev, MCI_NOTIFY_SUCCESSFUL);
+                plr_sleep(50);
             }
             opened = 1;
             return 0;
@@ -1335,73 +2072,73 @@ MCIERROR WINAPI fake_mciSendStringA(LPCTSTR cmd, LPTSTR ret, UINT cchReturn, HAN
         // Normal open cdaudio
         if (strstr(cmdbuf, "open cdaudio"))
         {
+            dev = &devices[0];
+            if (hwndCallback && strstr(cmdbuf, "notify"))
+                dev->notify_hwnd = (HWND)hwndCallback;
             //char devid_str[100];
             //sprintf(devid_str, "%d", MAGIC_DEVICEID);
             //if(cchReturn)strcpy(ret, devid_str); //Only fill the return buffer if it is expected (buffer size > 0)
             if ((strstr(cmdbuf, "notify")) && FullNotify && !opened){
                 dprintf("  MCI_NOTIFY\r\n");
                 dprintf("  Sending MCI_NOTIFY_SUCCESSFUL message...\r\n");
-                SendMessageA((HWND)0xffff, MM_MCINOTIFY, MCI_NOTIFY_SUCCESSFUL, MAGIC_DEVICEID);
-                Sleep(50);
+                mci_notify(dev, MCI_NOTIFY_SUCCESSFUL);
+                plr_sleep(50);
             }
             opened = 1;
             return 0;
         }
     }
 
-    /* reset alias with "close alias" string */
-    sprintf(cmp_str, "close %s", alias_s);
-    if (strstr(cmdbuf, cmp_str))
+    /* "close alias" frees the alias, cdaudio itself only gets its time format reset */
+    if (d && strcmp(verb, "close") == 0)
     {
-        sprintf(alias_s, "cdaudio");
-        time_format = MCI_FORMAT_MSF; // reset time format
         if ((strstr(cmdbuf, "notify")) && FullNotify && opened){
             notify = 0;
             dprintf("  MCI_NOTIFY\r\n");
             dprintf("  Sending MCI_NOTIFY_SUCCESSFUL message...\r\n");
-            SendMessageA((HWND)0xffff, MM_MCINOTIFY, MCI_NOTIFY_SUCCESSFUL, MAGIC_DEVICEID);
-            Sleep(50);
+            mci_notify(dev, MCI_NOTIFY_SUCCESSFUL);
+            plr_sleep(50);
         }
         opened = 0;
+        mci_device_close(dev);
         return 0;
     }
 
     /* Handle "set cdaudio/alias" */
-    sprintf(cmp_str, "set %s", alias_s);
-    if (strstr(cmdbuf, cmp_str)){
+    if (d && strcmp(verb, "set") == 0){
         if ((strstr(cmdbuf, "notify")) && FullNotify && opened){
             notify = 0;
             dprintf("  MCI_NOTIFY\r\n");
             dprintf("  Sending MCI_NOTIFY_SUCCESSFUL message...\r\n");
-            SendMessageA((HWND)0xffff, MM_MCINOTIFY, MCI_NOTIFY_SUCCESSFUL, MAGIC_DEVICEID);
-            Sleep(50);
+            mci_notify(dev, MCI_NOTIFY_SUCCESSFUL);
+            plr_sleep(50);
         }
         if (strstr(cmdbuf, "milliseconds"))
         {
             static MCI_SET_PARMS parms;
             parms.dwTimeFormat = MCI_FORMAT_MILLISECONDS;
-            fake_mciSendCommandA(MAGIC_DEVICEID, MCI_SET, MCI_SET_TIME_FORMAT, (DWORD_PTR)&parms);
+            emu_mciSendCommandA(dev->id, MCI_SET, MCI_SET_TIME_FORMAT, (DWORD_PTR)&parms);
             return 0;
         }
         if (strstr(cmdbuf, "tmsf"))
         {
             static MCI_SET_PARMS parms;
             parms.dwTimeFormat = MCI_FORMAT_TMSF;
-            fake_mciSendCommandA(MAGIC_DEVICEID, MCI_SET, MCI_SET_TIME_FORMAT, (DWORD_PTR)&parms);
+            emu_mciSendCommandA(dev->id, MCI_SET, MCI_SET_TIME_FORMAT, (DWORD_PTR)&parms);
             return 0;
         }
         if (strstr(cmdbuf, "msf"))
         {
             static MCI_SET_PARMS parms;
             parms.dwTimeFormat = MCI_FORMAT_MSF;
-            fake_mciSendCommandA(MAGIC_DEVICEID, MCI_SET, MCI_SET_TIME_FORMAT, (DWORD_PTR)&parms);
+            emu_mciSendCommandA(dev->id, MCI_SET, MCI_SET_TIME_FORMAT, (DWORD_PTR)&parms);
             return 0;
         }
         if (strstr(cmdbuf, "ms")) // Another accepted string for milliseconds
         {
             static MCI_SET_PARMS parms;
             parms.dwTimeFormat = MCI_FORMAT_MILLISECONDS;
-            fake_mciSendCommandA(MAGIC_DEVICEID, MCI_SET, MCI_SET_TIME_FORMAT, (DWORD_PTR)&parms);
+            emu_mciSendCommandA(dev->id, MCI_SET, MCI_SET_TIME_FORMAT, (DWORD_PTR)&parms);
             return 0;
         }
         if (strstr(cmdbuf, "audio all off"))
@@ -1422,26 +2159,25 @@ MCIERROR WINAPI fake_mciSendStringA(LPCTSTR cmd, LPTSTR ret, UINT cchReturn, HAN
     }
 
     /* Handle "status cdaudio/alias" */
-    sprintf(cmp_str, "status %s", alias_s);
-    if (strstr(cmdbuf, cmp_str)){
+    if (d && strcmp(verb, "status") == 0){
         if ((strstr(cmdbuf, "notify")) && FullNotify && opened){
             notify = 0;
             dprintf("  MCI_NOTIFY\r\n");
             dprintf("  Sending MCI_NOTIFY_SUCCESSFUL message...\r\n");
-            SendMessageA((HWND)0xffff, MM_MCINOTIFY, MCI_NOTIFY_SUCCESSFUL, MAGIC_DEVICEID);
-            Sleep(50);
+            mci_notify(dev, MCI_NOTIFY_SUCCESSFUL);
+            plr_sleep(50);
         }
         if (strstr(cmdbuf, "time format"))
         {
-            if(time_format==MCI_FORMAT_MILLISECONDS){
+            if(dev->time_format==MCI_FORMAT_MILLISECONDS){
                 strcpy(ret, "milliseconds");
                 return 0;
             }
-            if(time_format==MCI_FORMAT_TMSF){
+            if(dev->time_format==MCI_FORMAT_TMSF){
                 strcpy(ret, "tmsf");
                 return 0;
             }
-            if(time_format==MCI_FORMAT_MSF){
+            if(dev->time_format==MCI_FORMAT_MSF){
                 strcpy(ret, "msf");
                 return 0;
             }
@@ -1473,11 +2209,11 @@ MCIERROR WINAPI fake_mciSendStringA(LPCTSTR cmd, LPTSTR ret, UINT cchReturn, HAN
             static MCI_STATUS_PARMS parms;
             parms.dwItem = MCI_STATUS_LENGTH;
             parms.dwTrack = track;
-            fake_mciSendCommandA(MAGIC_DEVICEID, MCI_STATUS, MCI_STATUS_ITEM|MCI_TRACK, (DWORD_PTR)&parms);
-            if(time_format == MCI_FORMAT_MILLISECONDS){
+            emu_mciSendCommandA(dev->id, MCI_STATUS, MCI_STATUS_ITEM|MCI_TRACK, (DWORD_PTR)&parms);
+            if(dev->time_format == MCI_FORMAT_MILLISECONDS){
                 sprintf(ret, "%d", parms.dwReturn);
             }
-            if(time_format == MCI_FORMAT_MSF || time_format == MCI_FORMAT_TMSF){
+            if(dev->time_format == MCI_FORMAT_MSF || dev->time_format == MCI_FORMAT_TMSF){
                 sprintf(ret, "%02d:%02d:%02d", MCI_MSF_MINUTE(parms.dwReturn), MCI_MSF_SECOND(parms.dwReturn), MCI_MSF_FRAME(parms.dwReturn));
             }
             return 0;
@@ -1486,11 +2222,11 @@ MCIERROR WINAPI fake_mciSendStringA(LPCTSTR cmd, LPTSTR ret, UINT cchReturn, HAN
         {
             static MCI_STATUS_PARMS parms;
             parms.dwItem = MCI_STATUS_LENGTH;
-            fake_mciSendCommandA(MAGIC_DEVICEID, MCI_STATUS, MCI_STATUS_ITEM, (DWORD_PTR)&parms);
-            if(time_format == MCI_FORMAT_MILLISECONDS){
+            emu_mciSendCommandA(dev->id, MCI_STATUS, MCI_STATUS_ITEM, (DWORD_PTR)&parms);
+            if(dev->time_format == MCI_FORMAT_MILLISECONDS){
                 sprintf(ret, "%d", parms.dwReturn);
             }
-            if(time_format == MCI_FORMAT_MSF || time_format == MCI_FORMAT_TMSF){
+            if(dev->time_format == MCI_FORMAT_MSF || dev->time_format == MCI_FORMAT_TMSF){
                 sprintf(ret, "%02d:%02d:%02d", MCI_MSF_MINUTE(parms.dwReturn), MCI_MSF_SECOND(parms.dwReturn), MCI_MSF_FRAME(parms.dwReturn));
             }
             return 0;
@@ -1500,14 +2236,14 @@ MCIERROR WINAPI fake_mciSendStringA(LPCTSTR cmd, LPTSTR ret, UINT cchReturn, HAN
             static MCI_STATUS_PARMS parms;
             parms.dwItem = MCI_STATUS_POSITION;
             parms.dwTrack = track;
-            fake_mciSendCommandA(MAGIC_DEVICEID, MCI_STATUS, MCI_STATUS_ITEM|MCI_TRACK, (DWORD_PTR)&parms);
-            if(time_format == MCI_FORMAT_MILLISECONDS){
+            emu_mciSendCommandA(dev->id, MCI_STATUS, MCI_STATUS_ITEM|MCI_TRACK, (DWORD_PTR)&parms);
+            if(dev->time_format == MCI_FORMAT_MILLISECONDS){
                 sprintf(ret, "%d", parms.dwReturn);
             }
-            if(time_format == MCI_FORMAT_MSF){
+            if(dev->time_format == MCI_FORMAT_MSF){
                 sprintf(ret, "%02d:%02d:%02d", MCI_MSF_MINUTE(parms.dwReturn), MCI_MSF_SECOND(parms.dwReturn), MCI_MSF_FRAME(parms.dwReturn));
             }
-            if(time_format == MCI_FORMAT_TMSF){
+            if(dev->time_format == MCI_FORMAT_TMSF){
                 sprintf(ret, "%02d:%02d:%02d:%02d", MCI_TMSF_TRACK(parms.dwReturn), MCI_TMSF_MINUTE(parms.dwReturn), MCI_TMSF_SECOND(parms.dwReturn), MCI_TMSF_FRAME(parms.dwReturn));
             }
             return 0;
@@ -1517,14 +2253,14 @@ MCIERROR WINAPI fake_mciSendStringA(LPCTSTR cmd, LPTSTR ret, UINT cchReturn, HAN
             static MCI_STATUS_PARMS parms;
             parms.dwItem = MCI_STATUS_POSITION;
             parms.dwTrack = firstTrack;
-            fake_mciSendCommandA(MAGIC_DEVICEID, MCI_STATUS, MCI_STATUS_ITEM|MCI_TRACK, (DWORD_PTR)&parms);
-            if(time_format == MCI_FORMAT_MILLISECONDS){
+            emu_mciSendCommandA(dev->id, MCI_STATUS, MCI_STATUS_ITEM|MCI_TRACK, (DWORD_PTR)&parms);
+            if(dev->time_format == MCI_FORMAT_MILLISECONDS){
                 sprintf(ret, "%d", parms.dwReturn);
             }
-            if(time_format == MCI_FORMAT_MSF){
+            if(dev->time_format == MCI_FORMAT_MSF){
                 sprintf(ret, "%02d:%02d:%02d", MCI_MSF_MINUTE(parms.dwReturn), MCI_MSF_SECOND(parms.dwReturn), MCI_MSF_FRAME(parms.dwReturn));
             }
-            if(time_format == MCI_FORMAT_TMSF){
+            if(dev->time_format == MCI_FORMAT_TMSF){
                 parms.dwTrack = 1;
                 sprintf(ret, "%02d:%02d:%02d:%02d", MCI_TMSF_TRACK(parms.dwReturn), MCI_TMSF_MINUTE(parms.dwReturn), MCI_TMSF_SECOND(parms.dwReturn), MCI_TMSF_FRAME(parms.dwReturn));
             }
@@ -1534,14 +2270,14 @@ MCIERROR WINAPI fake_mciSendStringA(LPCTSTR cmd, LPTSTR ret, UINT cchReturn, HAN
         {
             static MCI_STATUS_PARMS parms;
             parms.dwItem = MCI_STATUS_POSITION;
-            fake_mciSendCommandA(MAGIC_DEVICEID, MCI_STATUS, MCI_STATUS_ITEM, (DWORD_PTR)&parms);
-            if(time_format == MCI_FORMAT_MILLISECONDS){
+            emu_mciSendCommandA(dev->id, MCI_STATUS, MCI_STATUS_ITEM, (DWORD_PTR)&parms);
+            if(dev->time_format == MCI_FORMAT_MILLISECONDS){
                 sprintf(ret, "%d", parms.dwReturn);
             }
-            if(time_format == MCI_FORMAT_MSF){
+            if(dev->time_format == MCI_FORMAT_MSF){
                 sprintf(ret, "%02d:%02d:%02d", MCI_MSF_MINUTE(parms.dwReturn), MCI_MSF_SECOND(parms.dwReturn), MCI_MSF_FRAME(parms.dwReturn));
             }
-            if(time_format == MCI_FORMAT_TMSF){
+            if(dev->time_format == MCI_FORMAT_TMSF){
                 sprintf(ret, "%02d:%02d:%02d:%02d", MCI_TMSF_TRACK(parms.dwReturn), MCI_TMSF_MINUTE(parms.dwReturn), MCI_TMSF_SECOND(parms.dwReturn), MCI_TMSF_FRAME(parms.dwReturn));
             }
             return 0;
@@ -1567,27 +2303,26 @@ MCIERROR WINAPI fake_mciSendStringA(LPCTSTR cmd, LPTSTR ret, UINT cchReturn, HAN
     }
 
     // Handle Seek cdaudio
-    sprintf(cmp_str, "seek %s", alias_s);
-    if (strstr(cmdbuf, cmp_str)){
+    if (d && strcmp(verb, "seek") == 0){
         if (strstr(cmdbuf, "notify")){
             if(FullNotify && opened)sendStringNotify = 1; /* storing the notify request */
         }
         if (strstr(cmdbuf, "to start")){
-            fake_mciSendCommandA(MAGIC_DEVICEID, MCI_SEEK, MCI_SEEK_TO_START, (DWORD_PTR)NULL);
+            emu_mciSendCommandA(dev->id, MCI_SEEK, MCI_SEEK_TO_START, (DWORD_PTR)NULL);
             return 0;
         }
         if (strstr(cmdbuf, "to end")){
-            fake_mciSendCommandA(MAGIC_DEVICEID, MCI_SEEK, MCI_SEEK_TO_END, (DWORD_PTR)NULL);
+            emu_mciSendCommandA(dev->id, MCI_SEEK, MCI_SEEK_TO_END, (DWORD_PTR)NULL);
             return 0;
         }
-        if(time_format == MCI_FORMAT_MSF){
+        if(dev->time_format == MCI_FORMAT_MSF){
             int seek_min = -1, seek_sec = -1, seek_frm = -1;
             if (sscanf(cmdbuf, "seek %*s to %d:%d:%d", &seek_min, &seek_sec, &seek_frm) == 3)
             {
                 dprintf("MSF seek to x:x:x\n");
                 static MCI_SEEK_PARMS parms;
                 parms.dwTo = MCI_MAKE_MSF(seek_min, seek_sec, 0);
-                fake_mciSendCommandA(MAGIC_DEVICEID, MCI_SEEK, MCI_TO, (DWORD_PTR)&parms);
+                emu_mciSendCommandA(dev->id, MCI_SEEK, MCI_TO, (DWORD_PTR)&parms);
                 return 0;
             }
             if (sscanf(cmdbuf, "seek %*s to %d:%d", &seek_min, &seek_sec) == 2)
@@ -1595,7 +2330,7 @@ MCIERROR WINAPI fake_mciSendStringA(LPCTSTR cmd, LPTSTR ret, UINT cchReturn, HAN
                 dprintf("MSF seek to x:x\n");
                 static MCI_SEEK_PARMS parms;
                 parms.dwTo = MCI_MAKE_MSF(seek_min, seek_sec, 0);
-                fake_mciSendCommandA(MAGIC_DEVICEID, MCI_SEEK, MCI_TO, (DWORD_PTR)&parms);
+                emu_mciSendCommandA(dev->id, MCI_SEEK, MCI_TO, (DWORD_PTR)&parms);
                 return 0;
             }
             if (sscanf(cmdbuf, "seek %*s to %d", &seek_min) == 1)
@@ -1603,18 +2338,18 @@ MCIERROR WINAPI fake_mciSendStringA(LPCTSTR cmd, LPTSTR ret, UINT cchReturn, HAN
                 dprintf("MSF seek to x\n");
                 static MCI_SEEK_PARMS parms;
                 parms.dwTo = MCI_MAKE_MSF(seek_min, 0, 0);
-                fake_mciSendCommandA(MAGIC_DEVICEID, MCI_SEEK, MCI_TO, (DWORD_PTR)&parms);
+                emu_mciSendCommandA(dev->id, MCI_SEEK, MCI_TO, (DWORD_PTR)&parms);
                 return 0;
             }
         }
-        else if(time_format == MCI_FORMAT_TMSF){
+        else if(dev->time_format == MCI_FORMAT_TMSF){
             int seek_track = -1, seek_min = -1, seek_sec = -1, seek_frm = -1;
             if (sscanf(cmdbuf, "seek %*s to %d:%d:%d:%d", &seek_track, &seek_min, &seek_sec, &seek_frm) == 4)
             {
                 dprintf("TMSF seek to x:x:x:x\n");
                 static MCI_SEEK_PARMS parms;
                 parms.dwTo = MCI_MAKE_TMSF(seek_track, seek_min, seek_sec, 0);
-                fake_mciSendCommandA(MAGIC_DEVICEID, MCI_SEEK, MCI_TO, (DWORD_PTR)&parms);
+                emu_mciSendCommandA(dev->id, MCI_SEEK, MCI_TO, (DWORD_PTR)&parms);
                 return 0;
             }
             if (sscanf(cmdbuf, "seek %*s to %d:%d:%d", &seek_track, &seek_min, &seek_sec) == 3)
@@ -1622,7 +2357,7 @@ MCIERROR WINAPI fake_mciSendStringA(LPCTSTR cmd, LPTSTR ret, UINT cchReturn, HAN
                 dprintf("TMSF seek to x:x:x\n");
                 static MCI_SEEK_PARMS parms;
                 parms.dwTo = MCI_MAKE_TMSF(seek_track, seek_min, seek_sec, 0);
-                fake_mciSendCommandA(MAGIC_DEVICEID, MCI_SEEK, MCI_TO, (DWORD_PTR)&parms);
+                emu_mciSendCommandA(dev->id, MCI_SEEK, MCI_TO, (DWORD_PTR)&parms);
                 return 0;
             }
             if (sscanf(cmdbuf, "seek %*s to %d:%d", &seek_track, &seek_min) == 2)
@@ -1630,7 +2365,7 @@ MCIERROR WINAPI fake_mciSendStringA(LPCTSTR cmd, LPTSTR ret, UINT cchReturn, HAN
                 dprintf("TMSF seek to x:x\n");
                 static MCI_SEEK_PARMS parms;
                 parms.dwTo = MCI_MAKE_TMSF(seek_track, seek_min, 0, 0);
-                fake_mciSendCommandA(MAGIC_DEVICEID, MCI_SEEK, MCI_TO, (DWORD_PTR)&parms);
+                emu_mciSendCommandA(dev->id, MCI_SEEK, MCI_TO, (DWORD_PTR)&parms);
                 return 0;
             }
             if (sscanf(cmdbuf, "seek %*s to %d", &seek_track) == 1)
@@ -1638,7 +2373,7 @@ MCIERROR WINAPI fake_mciSendStringA(LPCTSTR cmd, LPTSTR ret, UINT cchReturn, HAN
                 dprintf("TMSF seek to x\n");
                 static MCI_SEEK_PARMS parms;
                 parms.dwTo = MCI_MAKE_TMSF(seek_track, 0, 0, 0);
-                fake_mciSendCommandA(MAGIC_DEVICEID, MCI_SEEK, MCI_TO, (DWORD_PTR)&parms);
+                emu_mciSendCommandA(dev->id, MCI_SEEK, MCI_TO, (DWORD_PTR)&parms);
                 return 0;
             }
         }
@@ -1649,7 +2384,7 @@ MCIERROR WINAPI fake_mciSendStringA(LPCTSTR cmd, LPTSTR ret, UINT cchReturn, HAN
             {
                 static MCI_SEEK_PARMS parms;
                 parms.dwTo = seek_ms;
-                fake_mciSendCommandA(MAGIC_DEVICEID, MCI_SEEK, MCI_TO, (DWORD_PTR)&parms);
+                emu_mciSendCommandA(dev->id, MCI_SEEK, MCI_TO, (DWORD_PTR)&parms);
                 return 0;
             }
         }
@@ -1657,12 +2392,12 @@ MCIERROR WINAPI fake_mciSendStringA(LPCTSTR cmd, LPTSTR ret, UINT cchReturn, HAN
 
     /* Handle "play cdaudio/alias" */
     int from = -1, to = -1;
-    sprintf(cmp_str, "play %s", alias_s);
-    if (strstr(cmdbuf, cmp_str)){
+    DWORD wait = strstr(cmdbuf, " wait") ? MCI_WAIT : 0;
+    if (d && strcmp(verb, "play") == 0){
         if (strstr(cmdbuf, "notify")){
         sendStringNotify = 1; /* storing the notify request */
         }
-        if(time_format == MCI_FORMAT_MSF){
+        if(dev->time_format == MCI_FORMAT_MSF){
             int from_sec = -1, to_sec = -1; // seconds
             int from_frm = -1, to_frm = -1; // frames (ignored for now)
             if (sscanf(cmdbuf, "play %*s from %d:%d:%d to %d:%d:%d", &from, &from_sec, &from_frm, &to, &to_sec, &to_frm) == 6)
@@ -1671,7 +2406,7 @@ MCIERROR WINAPI fake_mciSendStringA(LPCTSTR cmd, LPTSTR ret, UINT cchReturn, HAN
                 static MCI_PLAY_PARMS parms;
                 parms.dwFrom = MCI_MAKE_MSF(from, from_sec, 0);
                 parms.dwTo = MCI_MAKE_MSF(to, to_sec, 0);
-                fake_mciSendCommandA(MAGIC_DEVICEID, MCI_PLAY, MCI_FROM|MCI_TO, (DWORD_PTR)&parms);
+                emu_mciSendCommandA(dev->id, MCI_PLAY, MCI_FROM|MCI_TO|wait, (DWORD_PTR)&parms);
                 return 0;
             }
             if (sscanf(cmdbuf, "play %*s from %d:%d:%d", &from, &from_sec, &from_frm) == 3)
@@ -1679,7 +2414,7 @@ MCIERROR WINAPI fake_mciSendStringA(LPCTSTR cmd, LPTSTR ret, UINT cchReturn, HAN
                 dprintf("MSF play from x:x:x\n");
                 static MCI_PLAY_PARMS parms;
                 parms.dwFrom = MCI_MAKE_MSF(from, from_sec, 0);
-                fake_mciSendCommandA(MAGIC_DEVICEID, MCI_PLAY, MCI_FROM, (DWORD_PTR)&parms);
+                emu_mciSendCommandA(dev->id, MCI_PLAY, MCI_FROM|wait, (DWORD_PTR)&parms);
                 return 0;
             }
             if (sscanf(cmdbuf, "play %*s to %d:%d:%d", &to, &to_sec, &to_frm) == 3)
@@ -1687,7 +2422,7 @@ MCIERROR WINAPI fake_mciSendStringA(LPCTSTR cmd, LPTSTR ret, UINT cchReturn, HAN
                 dprintf("MSF play to x:x:x\n");
                 static MCI_PLAY_PARMS parms;
                 parms.dwTo = MCI_MAKE_MSF(to, to_sec, 0);
-                fake_mciSendCommandA(MAGIC_DEVICEID, MCI_PLAY, MCI_TO, (DWORD_PTR)&parms);
+                emu_mciSendCommandA(dev->id, MCI_PLAY, MCI_TO|wait, (DWORD_PTR)&parms);
                 return 0;
             }
             if (sscanf(cmdbuf, "play %*s from %d:%d to %d:%d", &from, &from_sec, &to, &to_sec) == 4)
@@ -1696,7 +2431,7 @@ MCIERROR WINAPI fake_mciSendStringA(LPCTSTR cmd, LPTSTR ret, UINT cchReturn, HAN
                 static MCI_PLAY_PARMS parms;
                 parms.dwFrom = MCI_MAKE_MSF(from, from_sec, 0);
                 parms.dwTo = MCI_MAKE_MSF(to, to_sec, 0);
-                fake_mciSendCommandA(MAGIC_DEVICEID, MCI_PLAY, MCI_FROM|MCI_TO, (DWORD_PTR)&parms);
+                emu_mciSendCommandA(dev->id, MCI_PLAY, MCI_FROM|MCI_TO|wait, (DWORD_PTR)&parms);
                 return 0;
             }
             if (sscanf(cmdbuf, "play %*s from %d:%d", &from, &from_sec) == 2)
@@ -1704,7 +2439,7 @@ MCIERROR WINAPI fake_mciSendStringA(LPCTSTR cmd, LPTSTR ret, UINT cchReturn, HAN
                 dprintf("MSF play from x:x\n");
                 static MCI_PLAY_PARMS parms;
                 parms.dwFrom = MCI_MAKE_MSF(from, from_sec, 0);
-                fake_mciSendCommandA(MAGIC_DEVICEID, MCI_PLAY, MCI_FROM, (DWORD_PTR)&parms);
+                emu_mciSendCommandA(dev->id, MCI_PLAY, MCI_FROM|wait, (DWORD_PTR)&parms);
                 return 0;
             }
             if (sscanf(cmdbuf, "play %*s to %d:%d", &to, &to_sec) == 2)
@@ -1712,7 +2447,7 @@ MCIERROR WINAPI fake_mciSendStringA(LPCTSTR cmd, LPTSTR ret, UINT cchReturn, HAN
                 dprintf("MSF play to x:x\n");
                 static MCI_PLAY_PARMS parms;
                 parms.dwTo = MCI_MAKE_MSF(to, to_sec, 0);
-                fake_mciSendCommandA(MAGIC_DEVICEID, MCI_PLAY, MCI_TO, (DWORD_PTR)&parms);
+                emu_mciSendCommandA(dev->id, MCI_PLAY, MCI_TO|wait, (DWORD_PTR)&parms);
                 return 0;
             }
             if (sscanf(cmdbuf, "play %*s from %d to %d", &from, &to) == 2)
@@ -1721,7 +2456,7 @@ MCIERROR WINAPI fake_mciSendStringA(LPCTSTR cmd, LPTSTR ret, UINT cchReturn, HAN
                 static MCI_PLAY_PARMS parms;
                 parms.dwFrom = MCI_MAKE_MSF(from, 0, 0);
                 parms.dwTo = MCI_MAKE_MSF(to, 0, 0);
-                fake_mciSendCommandA(MAGIC_DEVICEID, MCI_PLAY, MCI_FROM|MCI_TO, (DWORD_PTR)&parms);
+                emu_mciSendCommandA(dev->id, MCI_PLAY, MCI_FROM|MCI_TO|wait, (DWORD_PTR)&parms);
                 return 0;
             }
             if (sscanf(cmdbuf, "play %*s from %d", &from) == 1)
@@ -1729,7 +2464,7 @@ MCIERROR WINAPI fake_mciSendStringA(LPCTSTR cmd, LPTSTR ret, UINT cchReturn, HAN
                 dprintf("MSF play from x\n");
                 static MCI_PLAY_PARMS parms;
                 parms.dwFrom = MCI_MAKE_MSF(from, 0, 0);
-                fake_mciSendCommandA(MAGIC_DEVICEID, MCI_PLAY, MCI_FROM, (DWORD_PTR)&parms);
+                emu_mciSendCommandA(dev->id, MCI_PLAY, MCI_FROM|wait, (DWORD_PTR)&parms);
                 return 0;
             }
             if (sscanf(cmdbuf, "play %*s to %d", &to) == 1)
@@ -1737,11 +2472,11 @@ MCIERROR WINAPI fake_mciSendStringA(LPCTSTR cmd, LPTSTR ret, UINT cchReturn, HAN
                 dprintf("MSF play to x\n");
                 static MCI_PLAY_PARMS parms;
                 parms.dwTo = MCI_MAKE_MSF(to, 0, 0);
-                fake_mciSendCommandA(MAGIC_DEVICEID, MCI_PLAY, MCI_TO, (DWORD_PTR)&parms);
+                emu_mciSendCommandA(dev->id, MCI_PLAY, MCI_TO|wait, (DWORD_PTR)&parms);
                 return 0;
             }
         }
-        else if(time_format == MCI_FORMAT_TMSF){
+        else if(dev->time_format == MCI_FORMAT_TMSF){
             int from_min = -1, to_min = -1; // minutes
             int from_sec = -1, to_sec = -1; // seconds
             int from_frm = -1, to_frm = -1; // frames (ignored for now)
@@ -1751,7 +2486,7 @@ MCIERROR WINAPI fake_mciSendStringA(LPCTSTR cmd, LPTSTR ret, UINT cchReturn, HAN
                 static MCI_PLAY_PARMS parms;
                 parms.dwFrom = MCI_MAKE_TMSF(from, from_min, from_sec, 0);
                 parms.dwTo = MCI_MAKE_TMSF(to, to_min, to_sec, 0);
-                fake_mciSendCommandA(MAGIC_DEVICEID, MCI_PLAY, MCI_FROM|MCI_TO, (DWORD_PTR)&parms);
+                emu_mciSendCommandA(dev->id, MCI_PLAY, MCI_FROM|MCI_TO|wait, (DWORD_PTR)&parms);
                 return 0;
             }
             if (sscanf(cmdbuf, "play %*s from %d:%d:%d:%d", &from, &from_min, &from_sec, &from_frm) == 4)
@@ -1759,7 +2494,7 @@ MCIERROR WINAPI fake_mciSendStringA(LPCTSTR cmd, LPTSTR ret, UINT cchReturn, HAN
                 dprintf("TMSF play from x:x:x:x\n");
                 static MCI_PLAY_PARMS parms;
                 parms.dwFrom = MCI_MAKE_TMSF(from, from_min, from_sec, 0);
-                fake_mciSendCommandA(MAGIC_DEVICEID, MCI_PLAY, MCI_FROM, (DWORD_PTR)&parms);
+                emu_mciSendCommandA(dev->id, MCI_PLAY, MCI_FROM|wait, (DWORD_PTR)&parms);
                 return 0;
             }
             if (sscanf(cmdbuf, "play %*s to %d:%d:%d:%d", &to, &to_min, &to_sec, &to_frm) == 4)
@@ -1767,7 +2502,7 @@ MCIERROR WINAPI fake_mciSendStringA(LPCTSTR cmd, LPTSTR ret, UINT cchReturn, HAN
                 dprintf("TMSF play to x:x:x:x\n");
                 static MCI_PLAY_PARMS parms;
                 parms.dwTo = MCI_MAKE_TMSF(to, to_min, to_sec, 0);
-                fake_mciSendCommandA(MAGIC_DEVICEID, MCI_PLAY, MCI_TO, (DWORD_PTR)&parms);
+                emu_mciSendCommandA(dev->id, MCI_PLAY, MCI_TO|wait, (DWORD_PTR)&parms);
                 return 0;
             }
             if (sscanf(cmdbuf, "play %*s from %d:%d:%d to %d:%d:%d", &from, &from_min, &from_sec, &to, &to_min, &to_sec) == 6)
@@ -1776,7 +2511,7 @@ MCIERROR WINAPI fake_mciSendStringA(LPCTSTR cmd, LPTSTR ret, UINT cchReturn, HAN
                 static MCI_PLAY_PARMS parms;
                 parms.dwFrom = MCI_MAKE_TMSF(from, from_min, from_sec, 0);
                 parms.dwTo = MCI_MAKE_TMSF(to, to_min, to_sec, 0);
-                fake_mciSendCommandA(MAGIC_DEVICEID, MCI_PLAY, MCI_FROM|MCI_TO, (DWORD_PTR)&parms);
+                emu_mciSendCommandA(dev->id, MCI_PLAY, MCI_FROM|MCI_TO|wait, (DWORD_PTR)&parms);
                 return 0;
             }
             if (sscanf(cmdbuf, "play %*s from %d:%d:%d", &from, &from_min, &from_sec) == 3)
@@ -1784,7 +2519,7 @@ MCIERROR WINAPI fake_mciSendStringA(LPCTSTR cmd, LPTSTR ret, UINT cchReturn, HAN
                 dprintf("TMSF play from x:x:x\n");
                 static MCI_PLAY_PARMS parms;
                 parms.dwFrom = MCI_MAKE_TMSF(from, from_min, from_sec, 0);
-                fake_mciSendCommandA(MAGIC_DEVICEID, MCI_PLAY, MCI_FROM, (DWORD_PTR)&parms);
+                emu_mciSendCommandA(dev->id, MCI_PLAY, MCI_FROM|wait, (DWORD_PTR)&parms);
                 return 0;
             }
             if (sscanf(cmdbuf, "play %*s to %d:%d:%d", &to, &to_min, &to_sec) == 3)
@@ -1792,7 +2527,7 @@ MCIERROR WINAPI fake_mciSendStringA(LPCTSTR cmd, LPTSTR ret, UINT cchReturn, HAN
                 dprintf("TMSF play to x:x:x\n");
                 static MCI_PLAY_PARMS parms;
                 parms.dwTo = MCI_MAKE_TMSF(to, to_min, to_sec, 0);
-                fake_mciSendCommandA(MAGIC_DEVICEID, MCI_PLAY, MCI_TO, (DWORD_PTR)&parms);
+                emu_mciSendCommandA(dev->id, MCI_PLAY, MCI_TO|wait, (DWORD_PTR)&parms);
                 return 0;
             }
             if (sscanf(cmdbuf, "play %*s from %d:%d to %d:%d", &from, &from_min, &to, &to_min) == 4)
@@ -1801,7 +2536,7 @@ MCIERROR WINAPI fake_mciSendStringA(LPCTSTR cmd, LPTSTR ret, UINT cchReturn, HAN
                 static MCI_PLAY_PARMS parms;
                 parms.dwFrom = MCI_MAKE_TMSF(from, from_min, 0, 0);
                 parms.dwTo = MCI_MAKE_TMSF(to, to_min, 0, 0);
-                fake_mciSendCommandA(MAGIC_DEVICEID, MCI_PLAY, MCI_FROM|MCI_TO, (DWORD_PTR)&parms);
+                emu_mciSendCommandA(dev->id, MCI_PLAY, MCI_FROM|MCI_TO|wait, (DWORD_PTR)&parms);
                 return 0;
             }
             if (sscanf(cmdbuf, "play %*s from %d:%d", &from, &from_min) == 2)
@@ -1809,7 +2544,7 @@ MCIERROR WINAPI fake_mciSendStringA(LPCTSTR cmd, LPTSTR ret, UINT cchReturn, HAN
                 dprintf("TMSF play from x:x\n");
                 static MCI_PLAY_PARMS parms;
                 parms.dwFrom = MCI_MAKE_TMSF(from, from_min, 0, 0);
-                fake_mciSendCommandA(MAGIC_DEVICEID, MCI_PLAY, MCI_FROM, (DWORD_PTR)&parms);
+                emu_mciSendCommandA(dev->id, MCI_PLAY, MCI_FROM|wait, (DWORD_PTR)&parms);
                 return 0;
             }
             if (sscanf(cmdbuf, "play %*s to %d:%d", &to, &to_min) == 2)
@@ -1817,7 +2552,7 @@ MCIERROR WINAPI fake_mciSendStringA(LPCTSTR cmd, LPTSTR ret, UINT cchReturn, HAN
                 dprintf("TMSF play to x:x\n");
                 static MCI_PLAY_PARMS parms;
                 parms.dwTo = MCI_MAKE_TMSF(to, to_min, 0, 0);
-                fake_mciSendCommandA(MAGIC_DEVICEID, MCI_PLAY, MCI_TO, (DWORD_PTR)&parms);
+                emu_mciSendCommandA(dev->id, MCI_PLAY, MCI_TO|wait, (DWORD_PTR)&parms);
                 return 0;
             }
             if (sscanf(cmdbuf, "play %*s from %d to %d", &from, &to) == 2)
@@ -1826,7 +2561,7 @@ MCIERROR WINAPI fake_mciSendStringA(LPCTSTR cmd, LPTSTR ret, UINT cchReturn, HAN
                 static MCI_PLAY_PARMS parms;
                 parms.dwFrom = MCI_MAKE_TMSF(from, 0, 0, 0);
                 parms.dwTo = MCI_MAKE_TMSF(to, 0, 0, 0);
-                fake_mciSendCommandA(MAGIC_DEVICEID, MCI_PLAY, MCI_FROM|MCI_TO, (DWORD_PTR)&parms);
+                emu_mciSendCommandA(dev->id, MCI_PLAY, MCI_FROM|MCI_TO|wait, (DWORD_PTR)&parms);
                 return 0;
             }
             if (sscanf(cmdbuf, "play %*s from %d", &from) == 1)
@@ -1834,7 +2569,7 @@ MCIERROR WINAPI fake_mciSendStringA(LPCTSTR cmd, LPTSTR ret, UINT cchReturn, HAN
                 dprintf("TMSF play from x\n");
                 static MCI_PLAY_PARMS parms;
                 parms.dwFrom = MCI_MAKE_TMSF(from, 0, 0, 0);
-                fake_mciSendCommandA(MAGIC_DEVICEID, MCI_PLAY, MCI_FROM, (DWORD_PTR)&parms);
+                emu_mciSendCommandA(dev->id, MCI_PLAY, MCI_FROM|wait, (DWORD_PTR)&parms);
                 return 0;
             }
             if (sscanf(cmdbuf, "play %*s to %d", &to) == 1)
@@ -1842,7 +2577,7 @@ MCIERROR WINAPI fake_mciSendStringA(LPCTSTR cmd, LPTSTR ret, UINT cchReturn, HAN
                 dprintf("TMSF play to x\n");
                 static MCI_PLAY_PARMS parms;
                 parms.dwTo = MCI_MAKE_TMSF(to, 0, 0, 0);
-                fake_mciSendCommandA(MAGIC_DEVICEID, MCI_PLAY, MCI_TO, (DWORD_PTR)&parms);
+                emu_mciSendCommandA(dev->id, MCI_PLAY, MCI_TO|wait, (DWORD_PTR)&parms);
                 return 0;
             }
         }
@@ -1853,33 +2588,176 @@ MCIERROR WINAPI fake_mciSendStringA(LPCTSTR cmd, LPTSTR ret, UINT cchReturn, HAN
                 static MCI_PLAY_PARMS parms;
                 parms.dwFrom = from;
                 parms.dwTo = to;
-                fake_mciSendCommandA(MAGIC_DEVICEID, MCI_PLAY, MCI_FROM|MCI_TO, (DWORD_PTR)&parms);
+                emu_mciSendCommandA(dev->id, MCI_PLAY, MCI_FROM|MCI_TO|wait, (DWORD_PTR)&parms);
                 return 0;
             }
             if (sscanf(cmdbuf, "play %*s from %d", &from) == 1)
             {
                 static MCI_PLAY_PARMS parms;
                 parms.dwFrom = from;
-                fake_mciSendCommandA(MAGIC_DEVICEID, MCI_PLAY, MCI_FROM, (DWORD_PTR)&parms);
+                emu_mciSendCommandA(dev->id, MCI_PLAY, MCI_FROM|wait, (DWORD_PTR)&parms);
                 return 0;
             }
             if (sscanf(cmdbuf, "play %*s to %d", &to) == 1)
             {
                 static MCI_PLAY_PARMS parms;
                 parms.dwTo = to;
-                fake_mciSendCommandA(MAGIC_DEVICEID, MCI_PLAY, MCI_TO, (DWORD_PTR)&parms);
+                emu_mciSendCommandA(dev->id, MCI_PLAY, MCI_TO|wait, (DWORD_PTR)&parms);
                 return 0;
             }
         }
     }
     // Handle play cdaudio null
-    if (strstr(cmdbuf, cmp_str)){
-        fake_mciSendCommandA(MAGIC_DEVICEID, MCI_PLAY, 0, (DWORD_PTR)NULL);
+    if (d && strcmp(verb, "play") == 0){
+        emu_mciSendCommandA(dev->id, MCI_PLAY, wait, (DWORD_PTR)NULL);
         return 0;
     }
 
     //return 0;
-    return relay_mciSendStringA(cmd, ret, cchReturn, hwndCallback); /* Added MCI relay */
+    return MCI_NOT_EMULATED;
+}
+
+static MCIERROR emu_mciSendStringA(LPCSTR cmd, LPSTR ret, UINT cchReturn, HANDLE hwndCallback)
+{
+    char cmdbuf[1024];
+
+    dprintf("[MCI String = %s]\n", cmd);
+
+    /* copy cmd into cmdbuf */
+    strcpy (cmdbuf,cmd);
+    /* change cmdbuf into lower case */
+    for (int i = 0; cmdbuf[i]; i++)
+    {
+        cmdbuf[i] = tolower(cmdbuf[i]);
+    }
+
+    MCIERROR err = emu_mciSendString(cmdbuf, ret, cchReturn, hwndCallback);
+    if (err == MCI_NOT_EMULATED)
+        return relay_mciSendStringA(cmd, ret, cchReturn, hwndCallback); /* Added MCI relay */
+
+    return err;
+}
+
+static MCIERROR emu_mciSendStringW(LPCWSTR cmd, LPWSTR ret, UINT cchReturn, HANDLE hwndCallback)
+{
+    char cmdbuf[1024];
+    char retbuf[256] = "";
+
+    mci_narrow(cmdbuf, sizeof cmdbuf, cmd, TRUE);
+    dprintf("[MCI String W = %s]\n", cmdbuf);
+
+    UINT cch = cchReturn < sizeof retbuf ? cchReturn : sizeof retbuf;
+    MCIERROR err = emu_mciSendString(cmdbuf, ret ? retbuf : NULL, ret ? cch : 0, hwndCallback);
+    if (err == MCI_NOT_EMULATED)
+        return relay_mciSendStringW(cmd, ret, cchReturn, hwndCallback);
+
+    /* only strings the A version would have returned, retbuf holds any of them */
+    if (ret && retbuf[0])
+        mci_widen(ret, cchReturn, retbuf);
+
+    return err;
+}
+
+/* Public MCI entry points, record the calls when tracing (Trace = 1) */
+MCIERROR WINAPI fake_mciSendCommandA(MCIDEVICEID IDDevice, UINT uMsg, DWORD_PTR fdwCommand, DWORD_PTR dwParam)
+{
+    if (!trace_enabled)
+        return emu_mciSendCommandA(IDDevice, uMsg, fdwCommand, dwParam);
+
+    ULONGLONG start = trace_clock();
+    MCIERROR ret = emu_mciSendCommandA(IDDevice, uMsg, fdwCommand, dwParam);
+    trace_command(start, IDDevice, uMsg, fdwCommand, dwParam, ret);
+    return ret;
+}
+
+MCIERROR WINAPI fake_mciSendStringA(LPCSTR cmd, LPSTR ret, UINT cchReturn, HANDLE hwndCallback)
+{
+    if (!trace_enabled)
+        return emu_mciSendStringA(cmd, ret, cchReturn, hwndCallback);
+
+    /* Commands without a return value leave the buffer alone, clear it
+       like the system implementation does so the trace holds no garbage. */
+    if (ret && cchReturn) ret[0] = '\0';
+
+    ULONGLONG start = trace_clock();
+    MCIERROR err = emu_mciSendStringA(cmd, ret, cchReturn, hwndCallback);
+    trace_string(start, cmd, ret, cchReturn, err);
+    return err;
+}
+
+/* a UTF-16 string of a W parameter struct for the trace, IDs stay as they are */
+static LPSTR mci_trace_narrow(char *buf, size_t size, LPCWSTR str)
+{
+    if (!str || IS_INTRESOURCE(str))
+        return (LPSTR)str;
+
+    mci_narrow(buf, size, str, FALSE);
+    return buf;
+}
+
+/* Commands of the W version are traced as A ones, the strings of their
+   parameter structs narrowed. */
+MCIERROR WINAPI fake_mciSendCommandW(MCIDEVICEID IDDevice, UINT uMsg, DWORD_PTR fdwCommand, DWORD_PTR dwParam)
+{
+    if (!trace_enabled)
+        return emu_mciSendCommand(IDDevice, uMsg, fdwCommand, dwParam, TRUE);
+
+    ULONGLONG start = trace_clock();
+    MCIERROR ret = emu_mciSendCommand(IDDevice, uMsg, fdwCommand, dwParam, TRUE);
+
+    if (dwParam && uMsg == MCI_OPEN)
+    {
+        LPMCI_OPEN_PARMSW w = (LPVOID)dwParam;
+        MCI_OPEN_PARMSA a;
+        char type[MAX_PATH], element[MAX_PATH], alias[MAX_PATH];
+
+        memcpy(&a, w, sizeof a);
+        if ((fdwCommand & MCI_OPEN_TYPE) && !(fdwCommand & MCI_OPEN_TYPE_ID))
+            a.lpstrDeviceType = mci_trace_narrow(type, sizeof type, w->lpstrDeviceType);
+        if ((fdwCommand & MCI_OPEN_ELEMENT) && !(fdwCommand & MCI_OPEN_ELEMENT_ID))
+            a.lpstrElementName = mci_trace_narrow(element, sizeof element, w->lpstrElementName);
+        if (fdwCommand & MCI_OPEN_ALIAS)
+            a.lpstrAlias = mci_trace_narrow(alias, sizeof alias, w->lpstrAlias);
+
+        trace_command(start, IDDevice, uMsg, fdwCommand, (DWORD_PTR)&a, ret);
+    }
+    else if (dwParam && (uMsg == MCI_INFO || uMsg == MCI_SYSINFO))
+    {
+        LPMCI_SYSINFO_PARMSW w = (LPVOID)dwParam;
+        MCI_SYSINFO_PARMSA a;
+        char str[1024] = "";
+
+        memset(&a, 0, sizeof a);
+        memcpy(&a, w, uMsg == MCI_INFO ? sizeof(MCI_INFO_PARMSW) : sizeof(MCI_SYSINFO_PARMSW));
+        if (ret == 0 && w->lpstrReturn && w->dwRetSize)
+            a.lpstrReturn = mci_trace_narrow(str, w->dwRetSize < sizeof str ? w->dwRetSize : sizeof str, w->lpstrReturn);
+
+        trace_command(start, IDDevice, uMsg, fdwCommand, (DWORD_PTR)&a, ret);
+    }
+    else
+    {
+        trace_command(start, IDDevice, uMsg, fdwCommand, dwParam, ret);
+    }
+
+    return ret;
+}
+
+/* Strings of the W version are traced narrowed to the A ones. */
+MCIERROR WINAPI fake_mciSendStringW(LPCWSTR cmd, LPWSTR ret, UINT cchReturn, HANDLE hwndCallback)
+{
+    if (!trace_enabled)
+        return emu_mciSendStringW(cmd, ret, cchReturn, hwndCallback);
+
+    if (ret && cchReturn) ret[0] = 0;
+
+    ULONGLONG start = trace_clock();
+    MCIERROR err = emu_mciSendStringW(cmd, ret, cchReturn, hwndCallback);
+
+    char cmdbuf[1024], retbuf[1024] = "";
+    mci_narrow(cmdbuf, sizeof cmdbuf, cmd, FALSE);
+    if (ret && cchReturn) mci_narrow(retbuf, sizeof retbuf, ret, FALSE);
+    trace_string(start, cmdbuf, retbuf, cchReturn, err);
+    return err;
 }
 
 UINT WINAPI fake_auxGetNumDevs()
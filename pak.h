@@ -0,0 +1,45 @@
+/* music.pak: all the tracks of a CD in one file, built by tools/oggpack.c
+
+   pak_header
+   pak_track[num_tracks]       sorted by track number
+   pak_seek[]                  seek tables of all tracks
+   track data                  the .ogg files as they are
+
+   All offsets are from the start of the file. */
+
+#define PAK_MAGIC       "OWPK"
+#define PAK_VERSION     1
+#define PAK_VORBIS      1
+
+#pragma pack(push, 1)
+
+struct pak_header
+{
+    char            magic[4];
+    DWORD           version;
+    DWORD           num_tracks;
+    DWORD           seek_interval;  /* ms between seek table entries */
+};
+
+struct pak_track
+{
+    DWORD           number;         /* CD track number */
+    DWORD           codec;
+    DWORD           channels;
+    DWORD           rate;
+    ULONGLONG       samples;        /* granule position of the last page */
+    DWORD           length;         /* seconds */
+    DWORD           position;       /* seconds from the start of the disc, pre-gap included */
+    DWORD           offset;
+    DWORD           size;
+    DWORD           seek_offset;
+    DWORD           seek_count;
+};
+
+struct pak_seek
+{
+    ULONGLONG       granule;        /* of the first page at or after the interval mark */
+    DWORD           offset;         /* of that page inside the track data */
+};
+
+#pragma pack(pop)
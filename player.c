@@ -1,22 +1,946 @@
+#ifdef TREMOR
+#include <tremor/ivorbisfile.h>
+#else
 #include <vorbis/vorbisfile.h>
+#endif
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <windows.h>
+#include "reader.h"
+#include "decoder.h"
+#include "resample.h"
 
 WAVEFORMATEX    plr_fmt;
 HWAVEOUT        plr_hwo         = NULL;
-OggVorbis_File  plr_vf;
+const struct decoder *plr_dec   = NULL;
+void            *plr_dh         = NULL;         /* decoder handle */
 HANDLE          plr_ev          = NULL;
 int             plr_cnt         = 0;
+int             plr_ended       = 0;            /* plr_pump() played the track to its end */
 int             plr_vol         = 100;
-WAVEHDR         *plr_buffers[3] = { NULL, NULL, NULL };
+char            plr_path[MAX_PATH];             /* track being played */
+ogg_int64_t     plr_pos         = 0;            /* next sample to play */
+ogg_int64_t     plr_dec_pos     = 0;            /* next sample the decoder returns */
+ogg_int64_t     plr_total       = 0;            /* track length in samples */
+ogg_int64_t     plr_start       = 0;            /* CUE track range inside the file */
+ogg_int64_t     plr_end         = 0;
 
-void plr_stop()
+/* Decoded track cache: PCM of recently played tracks (or their first
+   plr_cache_secs seconds) is kept in memory up to plr_cache_max bytes and
+   the least recently used tracks are dropped first. Replays and seeks inside
+   the cached part do not touch the decoder at all.
+   Warm start intros (plr_intro_ms) live in the same table as pinned entries
+   outside the budget, they let a track start before its file is opened. */
+struct plr_cache
 {
-    plr_cnt = 0;
+    char            path[MAX_PATH];
+    char            *pcm;
+    DWORD           size;       /* bytes reserved */
+    DWORD           filled;     /* bytes decoded from the start of the track */
+    ogg_int64_t     total;      /* track length in samples */
+    int             channels;
+    long            rate;
+    DWORD           used;       /* LRU stamp */
+    int             pinned;     /* warm start intro */
+};
+
+#define PLR_CACHE_ENTRIES 128
+
+struct plr_cache plr_cache[PLR_CACHE_ENTRIES];
+struct plr_cache *plr_cached    = NULL;
+DWORD           plr_cache_max   = 0;
+DWORD           plr_cache_secs  = 0;
+DWORD           plr_cache_bytes = 0;
+DWORD           plr_cache_tick  = 0;
+DWORD           plr_intro_ms    = 0;
+
+void plr_cache_limit(int mb, int secs)
+{
+    plr_cache_max = mb > 0 ? (DWORD)mb * 1024 * 1024 : 0;
+    plr_cache_secs = secs > 0 ? secs : 0;
+}
+
+void plr_warm_start(int ms)
+{
+    plr_intro_ms = ms > 0 ? ms : 0;
+}
+
+static void plr_cache_drop(struct plr_cache *c)
+{
+    if (!c->pinned)
+        plr_cache_bytes -= c->size;
+    free(c->pcm);
+    memset(c, 0, sizeof *c);
+}
+
+/* prefers a cached track over its intro */
+static struct plr_cache *plr_cache_find(const char *path)
+{
+    struct plr_cache *intro = NULL;
+    int i;
+
+    for (i = 0; i < PLR_CACHE_ENTRIES; i++)
+    {
+        if (plr_cache[i].pcm && strcmp(plr_cache[i].path, path) == 0)
+        {
+            if (plr_cache[i].pinned)
+            {
+                intro = &plr_cache[i];
+                continue;
+            }
+
+            plr_cache[i].used = ++plr_cache_tick;
+            return &plr_cache[i];
+        }
+    }
+
+    return intro;
+}
+
+/* reserves room for a track, evicting old ones until it fits the budget */
+static struct plr_cache *plr_cache_new(const char *path, ogg_int64_t total, int channels, long rate)
+{
+    ogg_int64_t samples = total;
+
+    if (plr_cache_secs && samples > (ogg_int64_t)plr_cache_secs * rate)
+        samples = (ogg_int64_t)plr_cache_secs * rate;
+
+    ogg_int64_t size = samples * channels * 2;
+
+    if (!plr_cache_max || size <= 0 || size > plr_cache_max)
+        return NULL;
+
+    while (1)
+    {
+        struct plr_cache *free_slot = NULL, *oldest = NULL;
+        int i;
+
+        for (i = 0; i < PLR_CACHE_ENTRIES; i++)
+        {
+            if (!plr_cache[i].pcm)
+            {
+                if (!free_slot) free_slot = &plr_cache[i];
+            }
+            else if (plr_cache[i].pinned)
+            {
+                continue;
+            }
+            else if (!oldest || plr_cache[i].used < oldest->used)
+            {
+                oldest = &plr_cache[i];
+            }
+        }
+
+        if (free_slot && plr_cache_bytes + size <= plr_cache_max)
+        {
+            free_slot->pcm = malloc(size);
+            if (!free_slot->pcm)
+                return NULL;
+
+            snprintf(free_slot->path, sizeof free_slot->path, "%s", path);
+            free_slot->size     = (DWORD)size;
+            free_slot->filled   = 0;
+            free_slot->total    = total;
+            free_slot->channels = channels;
+            free_slot->rate     = rate;
+            free_slot->used     = ++plr_cache_tick;
+            plr_cache_bytes += free_slot->size;
+            return free_slot;
+        }
+
+        if (!oldest)
+            return NULL;
+
+        plr_cache_drop(oldest);
+    }
+}
+
+/* Loop points: with plr_loop_tags the LOOPSTART/LOOPLENGTH (or LOOPEND)
+   comments of the tracks are read during the scan. When a track that has
+   them is played on its own the decoder jumps back to the loop start inside
+   the stream instead of ending, so the music loops without a gap. */
+struct plr_loop
+{
+    char            path[MAX_PATH];
+    ogg_int64_t     start;
+    ogg_int64_t     end;
+};
+
+#define PLR_LOOPS 99
+
+struct plr_loop plr_loops[PLR_LOOPS];
+int             plr_num_loops   = 0;
+int             plr_loop_tags   = 0;
+ogg_int64_t     plr_loop_start  = 0;
+ogg_int64_t     plr_loop_end    = 0;            /* 0 = not looping */
+
+void plr_use_loop_tags(int on)
+{
+    plr_loop_tags = on;
+}
+
+static void plr_read_loop(const struct decoder *dec, void *h, const char *path)
+{
+    ogg_int64_t start = -1, length = -1, end = -1, total;
+    const char *c;
+    int i, channels;
+    long rate;
+
+    if (!dec->info(h, &channels, &rate, &total))
+        return;
+
+    for (i = 0; (c = dec->comment(h, i)) != NULL; i++)
+    {
+        if (_strnicmp(c, "LOOPSTART=", 10) == 0)
+            start = _atoi64(c + 10);
+        else if (_strnicmp(c, "LOOPLENGTH=", 11) == 0)
+            length = _atoi64(c + 11);
+        else if (_strnicmp(c, "LOOPEND=", 8) == 0)
+            end = _atoi64(c + 8);
+    }
+
+    if (start < 0)
+        return;
+
+    if (length > 0)
+        end = start + length;
+
+    if (end <= start || end > total)
+        end = total;
+
+    if (start >= end)
+        return;
+
+    for (i = 0; i < plr_num_loops; i++)
+        if (strcmp(plr_loops[i].path, path) == 0)
+            break;
+
+    if (i == PLR_LOOPS)
+        return;
+
+    snprintf(plr_loops[i].path, sizeof plr_loops[i].path, "%s", path);
+    plr_loops[i].start = start;
+    plr_loops[i].end = end;
+
+    if (i == plr_num_loops)
+        plr_num_loops++;
+}
+
+/* turns looping on for the current track if it has loop points */
+void plr_loop(int on)
+{
+    int i;
+
+    plr_loop_start = plr_loop_end = 0;
+
+    if (!on || !plr_path[0])
+        return;
+
+    for (i = 0; i < plr_num_loops; i++)
+    {
+        if (strcmp(plr_loops[i].path, plr_path) == 0)
+        {
+            plr_loop_start = plr_loops[i].start;
+            plr_loop_end = plr_loops[i].end;
+            return;
+        }
+    }
+}
+
+/* Virtual clock: no waveOut device is opened, a buffer counts as played the
+   moment it is queued and the clock advances by its length instead. A harness
+   moves the limit with plr_vlimit() to run scripts faster than real time. */
+int             plr_virtual     = 0;
+ULONGLONG       plr_vtime       = 0;                /* microseconds */
+ULONGLONG       plr_vend        = (ULONGLONG)-1;    /* pump blocks here */
+HANDLE          plr_vstep       = NULL;             /* limit was moved */
+HANDLE          plr_vblock      = NULL;             /* pump reached the limit */
+
+void plr_virtual_clock(int on)
+{
+    plr_virtual = on;
+    plr_vtime = 0;
+    plr_vend = (ULONGLONG)-1;
+
+    if (on && !plr_vstep)
+    {
+        plr_vstep = CreateEvent(NULL, 0, 0, NULL);
+        plr_vblock = CreateEvent(NULL, 0, 0, NULL);
+    }
+}
+
+DWORD plr_time()
+{
+    if (plr_virtual)
+        return (DWORD)(plr_vtime / 1000);
+
+    return timeGetTime();
+}
+
+/* Wall clock waits are skipped in virtual mode, time only moves with audio. */
+void plr_sleep(DWORD ms)
+{
+    if (!plr_virtual)
+        Sleep(ms);
+}
+
+void plr_vlimit(DWORD ms)
+{
+    plr_vend = (ULONGLONG)ms * 1000;
+    SetEvent(plr_vstep);
+}
+
+/* Capture: in virtual mode everything the sink consumes can be written to a
+   WAV file, including the silence while nothing is playing. The format is
+   fixed up front: stereo at the output rate, which capturing sets to 44.1kHz
+   when OutputRate did not, so every track is resampled to it. A track that
+   still comes out in another format (more than two channels) is refused. */
+FILE            *plr_wav        = NULL;
+DWORD           plr_wav_bytes   = 0;
+WAVEFORMATEX    plr_wav_fmt;
+
+extern DWORD plr_out_rate;
+
+int plr_capture(const char *path)
+{
+    plr_wav = fopen(path, "wb");
+
+    if (!plr_wav)
+        return 0;
+
+    if (!plr_out_rate)
+        plr_out_rate = 44100;
+
+    plr_wav_bytes = 0;
+    plr_wav_fmt.wFormatTag      = WAVE_FORMAT_PCM;
+    plr_wav_fmt.nChannels       = 2;
+    plr_wav_fmt.nSamplesPerSec  = plr_out_rate;
+    plr_wav_fmt.wBitsPerSample  = 16;
+    plr_wav_fmt.nBlockAlign     = 4;
+    plr_wav_fmt.nAvgBytesPerSec = plr_out_rate * 4;
+    plr_wav_fmt.cbSize          = 0;
+
+    /* header is written once the size is known */
+    char hdr[44] = { 0 };
+    fwrite(hdr, sizeof hdr, 1, plr_wav);
+
+    return 1;
+}
+
+void plr_capture_close()
+{
+    if (!plr_wav)
+        return;
+
+    DWORD riff = 36 + plr_wav_bytes, fmt_size = 16;
+
+    fseek(plr_wav, 0, SEEK_SET);
+    fwrite("RIFF", 4, 1, plr_wav);
+    fwrite(&riff, 4, 1, plr_wav);
+    fwrite("WAVEfmt ", 8, 1, plr_wav);
+    fwrite(&fmt_size, 4, 1, plr_wav);
+    fwrite(&plr_wav_fmt, 16, 1, plr_wav);
+    fwrite("data", 4, 1, plr_wav);
+    fwrite(&plr_wav_bytes, 4, 1, plr_wav);
+
+    fclose(plr_wav);
+    plr_wav = NULL;
+}
+
+/* Clock advances on its own while nothing is playing. */
+void plr_vidle(DWORD ms)
+{
+    ULONGLONG until = (ULONGLONG)ms * 1000;
+
+    if (plr_vtime >= until)
+        return;
+
+    if (plr_wav)
+    {
+        static const char zero[4096];
+        DWORD bytes = (DWORD)((until - plr_vtime) * plr_wav_fmt.nAvgBytesPerSec / 1000000);
+        bytes -= bytes % plr_wav_fmt.nBlockAlign;
+        plr_wav_bytes += bytes;
+
+        while (bytes)
+        {
+            DWORD n = bytes < sizeof zero ? bytes : sizeof zero;
+            fwrite(zero, n, 1, plr_wav);
+            bytes -= n;
+        }
+    }
+
+    plr_vtime = until;
+}
+
+/* Read-ahead: with plr_ahead set, track files are read through a background
+   reader (reader.c) and the next track of a play range is opened
+   PLR_PREFETCH_SECS before the current one ends. */
+#define PLR_PREFETCH_SECS 5
+
+struct reader   *plr_reader     = NULL;
+struct reader   *plr_next       = NULL;
+char            plr_next_path[MAX_PATH];
+DWORD           plr_ahead       = 0;
+
+void plr_read_ahead(int kb)
+{
+    plr_ahead = kb > 0 ? (DWORD)kb * 1024 : 0;
+}
+
+static int plr_is_raw(const char *path);
+
+/* raw PCM files are mapped when played, only encoded tracks are preloaded */
+DWORD plr_preload(const char **paths, int num)
+{
+    const char **encoded = calloc(num > 0 ? num : 1, sizeof *encoded);
+    int i, n = 0;
+
+    for (i = 0; i < num; i++)
+        if (!plr_is_raw(paths[i])) encoded[n++] = paths[i];
+
+    DWORD ret = n ? reader_preload(encoded, n) : 0;
+    free(encoded);
+    return ret;
+}
+
+const struct pak_header *plr_pak(const char *path, const char *dir)
+{
+    return reader_pak(path, dir);
+}
+
+void plr_prefetch(const char *path)
+{
+    /* the next CUE track is already open */
+    if (path && strcmp(path, plr_path) == 0)
+        path = NULL;
+
+    if (path && plr_next && strcmp(reader_path(plr_next), path) == 0)
+        return;
+
+    reader_close(plr_next);
+    plr_next = NULL;
+    snprintf(plr_next_path, sizeof plr_next_path, "%s", path ? path : "");
+}
+
+/* preloaded tracks (reader_preload) are opened from memory even without
+   read-ahead, everything else goes through stdio then */
+static int plr_open(const char *path)
+{
+    if (plr_next && strcmp(reader_path(plr_next), path) == 0)
+    {
+        plr_reader = plr_next;
+        plr_next = NULL;
+        plr_next_path[0] = '\0';
+    }
+    else
+    {
+        plr_reader = reader_open(path, plr_ahead);
+    }
+
+    struct source src;
+
+    if (plr_reader)
+    {
+        src.datasource = plr_reader;
+        src.callbacks = reader_callbacks;
+        src.seeks = reader_seeks(plr_reader, &src.num_seeks);
+    }
+    else if (plr_ahead || !source_file(&src, path))
+    {
+        return OV_EREAD;
+    }
+
+    plr_dec = decoder_open(&src, &plr_dh);
+
+    if (!plr_dec)
+    {
+        source_close(&src);
+        reader_close(plr_reader);
+        plr_reader = NULL;
+        return OV_ENOTVORBIS;
+    }
+
+    return 0;
+}
+
+static void plr_close()
+{
+    if (plr_dh)
+        plr_dec->close(plr_dh);
+
+    plr_dec = NULL;
+    plr_dh = NULL;
+    reader_close(plr_reader);
+    plr_reader = NULL;
+}
 
-    if (plr_vf.datasource)
-        ov_clear(&plr_vf);
+/* set while another thread waits for the pumping thread to give up */
+volatile int    plr_abort       = 0;
+
+static void plr_vwait()
+{
+    while (plr_vtime >= plr_vend && !plr_abort)
+    {
+        SetEvent(plr_vblock);
+        WaitForSingleObject(plr_vstep, INFINITE);
+    }
+}
+
+/* Raw PCM sources (WAV files, CD-DA BIN images) are memory mapped and need
+   no decoding. A BIN image is often most of a CD, so only a window of
+   PLR_RAW_WINDOW around the play position is mapped and moved along as
+   playback advances. At full volume the wave buffers point straight into
+   the window, each of them holding a reference to it in dwUser so it stays
+   mapped until plr_free(). */
+#define PLR_RAW_WINDOW  (4 << 20)
+
+struct plr_view
+{
+    char            *base;
+    ULONGLONG       offset;     /* in the file */
+    DWORD           size;
+    int             refs;       /* the source and the queued buffers */
+};
+
+struct plr_raw
+{
+    HANDLE          map;
+    ULONGLONG       size;       /* of the file */
+    ULONGLONG       data;       /* offset of the first sample */
+    struct plr_view *view;
+    int             channels;
+    long            rate;
+    ogg_int64_t     total;
+};
+
+struct plr_raw  plr_raw;
+
+static int plr_is_raw(const char *path)
+{
+    const char *ext = strrchr(path, '.');
+    return ext && (_stricmp(ext, ".wav") == 0 || _stricmp(ext, ".bin") == 0);
+}
+
+static void plr_view_release(struct plr_view *v)
+{
+    if (v && --v->refs == 0)
+    {
+        UnmapViewOfFile(v->base);
+        free(v);
+    }
+}
+
+static void plr_raw_close(struct plr_raw *r)
+{
+    plr_view_release(r->view);
+    if (r->map) CloseHandle(r->map);
+    memset(r, 0, sizeof *r);
+}
+
+static int plr_raw_read(HANDLE file, ULONGLONG offset, void *buf, DWORD len)
+{
+    LONG high = (LONG)(offset >> 32);
+    DWORD read = 0;
+
+    if (SetFilePointer(file, (LONG)offset, &high, FILE_BEGIN) == INVALID_SET_FILE_POINTER && GetLastError() != NO_ERROR)
+        return 0;
+
+    return ReadFile(file, buf, len, &read, NULL) && read == len;
+}
+
+static int plr_raw_open(struct plr_raw *r, const char *path)
+{
+    HANDLE file = CreateFile(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL);
+
+    memset(r, 0, sizeof *r);
+
+    if (file == INVALID_HANDLE_VALUE)
+        return 0;
+
+    DWORD high = 0, low = GetFileSize(file, &high);
+    ULONGLONG size = ((ULONGLONG)high << 32) | low, bytes = size;
+
+    /* BIN images are 44.1 kHz 16-bit stereo CD-DA */
+    r->size = size;
+    r->channels = 2;
+    r->rate = 44100;
+
+    if (_stricmp(strrchr(path, '.'), ".wav") == 0)
+    {
+        ULONGLONG offset = 12;
+        unsigned char riff[12];
+        PCMWAVEFORMAT fmt;
+        int has_fmt = 0, has_data = 0;
+
+        if (!plr_raw_read(file, 0, riff, 12) || memcmp(riff, "RIFF", 4) != 0 || memcmp(riff + 8, "WAVE", 4) != 0)
+        {
+            CloseHandle(file);
+            return 0;
+        }
+
+        while (offset + 8 <= size && !has_data)
+        {
+            DWORD chunk[2];
+
+            if (!plr_raw_read(file, offset, chunk, 8))
+                break;
+
+            if (chunk[1] > size - offset - 8)
+                chunk[1] = (DWORD)(size - offset - 8);
+
+            if (memcmp(chunk, "fmt ", 4) == 0 && chunk[1] >= 16)
+                has_fmt = plr_raw_read(file, offset + 8, &fmt, sizeof fmt);
+
+            if (memcmp(chunk, "data", 4) == 0 && has_fmt)
+            {
+                r->data = offset + 8;
+                bytes = chunk[1];
+                has_data = 1;
+            }
+
+            offset += 8 + chunk[1] + (chunk[1] & 1);
+        }
+
+        if (!has_data || fmt.wf.wFormatTag != WAVE_FORMAT_PCM || fmt.wBitsPerSample != 16 || !fmt.wf.nChannels || !fmt.wf.nSamplesPerSec)
+        {
+            CloseHandle(file);
+            return 0;
+        }
+
+        r->channels = fmt.wf.nChannels;
+        r->rate = fmt.wf.nSamplesPerSec;
+    }
+
+    if (size)
+        r->map = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+
+    if (!r->map)
+        return 0;
+
+    r->total = bytes / (r->channels * 2);
+    return 1;
+}
+
+/* the samples from frame on, *len is cut to what the mapped window holds */
+static char *plr_raw_at(struct plr_raw *r, ogg_int64_t frame, int *len)
+{
+    static DWORD granularity = 0;
+    ULONGLONG pos = r->data + frame * r->channels * 2;
+    struct plr_view *v = r->view;
+
+    if (!v || pos < v->offset || (pos + *len > v->offset + v->size && v->offset + v->size < r->size))
+    {
+        if (!granularity)
+        {
+            SYSTEM_INFO si;
+            GetSystemInfo(&si);
+            granularity = si.dwAllocationGranularity;
+        }
+
+        ULONGLONG offset = pos - pos % granularity;
+        DWORD size = r->size - offset < PLR_RAW_WINDOW ? (DWORD)(r->size - offset) : PLR_RAW_WINDOW;
+        char *base = MapViewOfFile(r->map, FILE_MAP_READ, (DWORD)(offset >> 32), (DWORD)offset, size);
+
+        if (!base)
+            return NULL;
+
+        plr_view_release(r->view);
+        v = r->view = malloc(sizeof *v);
+        v->base = base;
+        v->offset = offset;
+        v->size = size;
+        v->refs = 1;
+    }
+
+    if (pos + *len > v->offset + v->size)
+        *len = (int)(v->offset + v->size - pos);
+    *len -= *len % (r->channels * 2);
+
+    return v->base + (pos - v->offset);
+}
+
+/* frees a wave buffer, one in a raw PCM window only lets go of the window */
+static void plr_free(WAVEHDR *header)
+{
+    if (header->dwUser)
+        plr_view_release((struct plr_view *)header->dwUser);
+    else
+        free(header->lpData);
+    free(header);
+}
+
+/* Buffering: blocks of plr_buf_ms are queued up to plr_depth deep. The
+   fixed profile keeps the original three blocks of 250 ms. The adaptive
+   ones measure how long a block takes to be made (decoding, resampling)
+   and how irregularly the device completes them (jitter), and keep enough
+   audio queued to cover both. An underrun or a thin margin grows the queue,
+   depth first and then the block size. A long calm stretch with a wide
+   margin shrinks it again, block size first.
+   With plr_late_ms set the device gets the blocks in
+   sub-blocks of PLR_SUB_MS and holds no more than plr_late_cur of them, see
+   plr_gain(). The adaptive profiles then resize that lead instead, between
+   plr_late_ms and PLR_LATE_MAX. */
+#define PLR_MAX_BUFFERS 64
+#define PLR_SUB_MS      20
+#define PLR_LATE_MAX    (PLR_SUB_MS * PLR_MAX_BUFFERS / 2)
+
+WAVEHDR         *plr_buffers[PLR_MAX_BUFFERS];
+int             plr_adaptive    = 0;
+DWORD           plr_buf_ms      = 250;
+DWORD           plr_buf_min     = 250;
+DWORD           plr_buf_max     = 250;
+int             plr_depth       = 3;
+int             plr_depth_min   = 3;
+int             plr_depth_max   = 3;
+LONGLONG        plr_make_us     = 0;    /* running averages */
+LONGLONG        plr_jitter_us   = 0;
+LONGLONG        plr_done_us     = 0;    /* last completion seen */
+int             plr_calm        = 0;    /* blocks since the queue was resized */
+int             plr_late_ms     = 0;    /* VolumeLatencyMs */
+int             plr_late_cur    = 0;
+
+void plr_buffering(int profile, int min_ms, int max_ms)
+{
+    static const struct { DWORD ms, min, max; int depth, dmin, dmax; } profiles[] =
+    {
+        { 250, 250,  250, 3, 3, 3 },    /* 0: fixed */
+        { 250, 100,  500, 3, 2, 6 },    /* 1: adaptive */
+        {  40,  20,  120, 4, 3, 8 },    /* 2: low latency */
+        { 500, 250, 1000, 3, 2, 4 },    /* 3: power saver */
+    };
+
+    if (profile < 0 || profile > 3)
+        profile = 0;
+
+    plr_adaptive  = profile != 0;
+    plr_buf_ms    = profiles[profile].ms;
+    plr_buf_min   = profiles[profile].min;
+    plr_buf_max   = profiles[profile].max;
+    plr_depth     = profiles[profile].depth;
+    plr_depth_min = profiles[profile].dmin;
+    plr_depth_max = profiles[profile].dmax;
+
+    if (plr_adaptive && min_ms > 0)
+        plr_buf_min = min_ms;
+    if (plr_adaptive && max_ms > 0)
+        plr_buf_max = max_ms;
+    if (plr_buf_max < plr_buf_min)
+        plr_buf_max = plr_buf_min;
+
+    if (plr_buf_ms < plr_buf_min) plr_buf_ms = plr_buf_min;
+    if (plr_buf_ms > plr_buf_max) plr_buf_ms = plr_buf_max;
+}
+
+/* when audio was last handed to the wave device */
+LONGLONG        plr_written_us  = 0;
+
+LONGLONG plr_us()
+{
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER now;
+
+    if (!freq.QuadPart)
+        QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+
+    return now.QuadPart / freq.QuadPart * 1000000 + now.QuadPart % freq.QuadPart * 1000000 / freq.QuadPart;
+}
+
+static void plr_grow()
+{
+    if (plr_late_ms)
+        plr_late_cur = plr_late_cur + PLR_SUB_MS < PLR_LATE_MAX ? plr_late_cur + PLR_SUB_MS : PLR_LATE_MAX;
+    else if (plr_depth < plr_depth_max)
+        plr_depth++;
+    else if (plr_buf_ms < plr_buf_max)
+        plr_buf_ms = plr_buf_ms * 3 / 2 < plr_buf_max ? plr_buf_ms * 3 / 2 : plr_buf_max;
+
+    plr_calm = 0;
+}
+
+static void plr_shrink()
+{
+    if (plr_late_ms)
+        plr_late_cur = plr_late_cur - PLR_SUB_MS > plr_late_ms ? plr_late_cur - PLR_SUB_MS : plr_late_ms;
+    else if (plr_buf_ms > plr_buf_min)
+        plr_buf_ms = plr_buf_ms * 4 / 5 > plr_buf_min ? plr_buf_ms * 4 / 5 : plr_buf_min;
+    else if (plr_depth > plr_depth_min)
+        plr_depth--;
+
+    plr_calm = 0;
+}
+
+/* the length of what the device is given at a time */
+static LONGLONG plr_unit_us()
+{
+    return (LONGLONG)(plr_late_ms ? PLR_SUB_MS : plr_buf_ms) * 1000;
+}
+
+/* a block was queued after make_us of work, queued blocks (or sub-blocks)
+   are now waiting */
+static void plr_adapt(LONGLONG make_us, int queued)
+{
+    plr_make_us += (make_us - plr_make_us) / 8;
+
+    /* what is left to play when the next block has to be there */
+    LONGLONG margin_us = (LONGLONG)(queued - 1) * plr_unit_us();
+    LONGLONG need_us = 2 * (plr_make_us + plr_jitter_us) + 10000;
+
+    plr_calm++;
+
+    if (margin_us < need_us && plr_calm >= plr_depth)
+        plr_grow();
+    else if (margin_us > 3 * need_us && plr_calm >= 50)
+        plr_shrink();
+}
+
+/* a wait for the device ended, the interval between completions should be
+   one block, pauses and seeks are not counted */
+static void plr_completed()
+{
+    LONGLONG now = plr_us(), block_us = plr_unit_us();
+    LONGLONG late = now - plr_done_us - block_us;
+
+    if (plr_done_us && late < 3 * block_us)
+        plr_jitter_us += ((late < 0 ? -late : late) - plr_jitter_us) / 8;
+
+    plr_done_us = now;
+}
+
+/* frees the buffers the device is done with, returns how many are queued */
+static int plr_reap()
+{
+    int i, queued = 0;
+
+    for (i = 0; i < PLR_MAX_BUFFERS; i++)
+    {
+        if (plr_buffers[i] && plr_buffers[i]->dwFlags & WHDR_DONE)
+        {
+            waveOutUnprepareHeader(plr_hwo, plr_buffers[i], sizeof(WAVEHDR));
+            plr_free(plr_buffers[i]);
+            plr_buffers[i] = NULL;
+        }
+
+        if (plr_buffers[i])
+            queued++;
+    }
+
+    return queued;
+}
+
+/* Output rate: with plr_out_rate set, mono and stereo tracks are resampled
+   to stereo at that rate, so the device keeps one format and stays open from
+   track to track. plr_fmt is the format of the track, plr_out the one the
+   device is opened with. */
+WAVEFORMATEX    plr_out;
+DWORD           plr_out_rate    = 0;
+struct resampler *plr_rs        = NULL;
+
+void plr_output_rate(int rate)
+{
+    plr_out_rate = rate > 0 ? rate : 0;
+}
+
+/* Volume is applied as the audio is handed to the device, not when it is
+   decoded. Changes ramp linearly over PLR_RAMP_MS so fades are smooth. With
+   plr_late_ms set, the device is fed sub-blocks of PLR_SUB_MS and holds no
+   more than plr_late_cur of them, the decoded block waits in between, so a
+   change is heard within that time instead of after the whole queue. */
+#define PLR_RAMP_MS     20
+#define PLR_UNITY       65536
+
+int             plr_gain_now    = PLR_UNITY;    /* at the end of the last block */
+
+void plr_volume_latency(int ms)
+{
+    if (ms > PLR_LATE_MAX)
+        ms = PLR_LATE_MAX;
+
+    plr_late_ms = plr_late_cur = ms > 0 ? (ms < PLR_SUB_MS * 2 ? PLR_SUB_MS * 2 : ms) : 0;
+}
+
+/* the gain plr_gain() is heading to */
+static int plr_gain_target()
+{
+    return plr_vol * PLR_UNITY / 100;
+}
+
+/* copies frames of 16-bit audio from src to dst (may be the same) at the
+   current volume */
+static void plr_gain(short *dst, const short *src, int frames)
+{
+    int target = plr_gain_target(), channels = plr_out.nChannels;
+    int ramp = plr_out.nSamplesPerSec / 1000 * PLR_RAMP_MS, i, c;
+
+    if (ramp > frames)
+        ramp = frames;
+
+    if (plr_gain_now != target && ramp > 0)
+    {
+        int step = (target - plr_gain_now) / ramp, g = plr_gain_now;
+
+        for (i = 0; i < ramp; i++, g += step)
+        {
+            for (c = 0; c < channels; c++, src++, dst++)
+                *dst = (short)(*src * g >> 16);
+        }
+
+        frames -= ramp;
+        plr_gain_now = target;
+    }
+
+    if (target == PLR_UNITY)
+    {
+        if (dst != src)
+            memcpy(dst, src, frames * channels * sizeof(short));
+        return;
+    }
+
+    for (i = frames * channels; i > 0; i--)
+        *dst++ = (short)(*src++ * target >> 16);
+}
+
+/* an ini file edited by hand overrides the volume of the tracks (the first
+   line, 0-100), it is written with the defaults when missing */
+static void plr_volume_override()
+{
+    int ogg_winmm_vol = 100;
+    FILE *fp = fopen("winmm.ini", "r");
+
+    if (fp != NULL)
+    {
+        fscanf(fp, "%d", &ogg_winmm_vol);
+        fclose(fp);
+        if (ogg_winmm_vol < 0) ogg_winmm_vol = 0;
+        if (ogg_winmm_vol > 100) ogg_winmm_vol = 100;
+        if (ogg_winmm_vol != 100) plr_vol = ogg_winmm_vol;
+    }
+    else if ((fp = fopen("winmm.ini", "w+")) != NULL)
+    {
+        fprintf(fp, "%d\n"
+                    "#\n"
+                    "# Winmm.dll emulated CD music volume override.\n"
+                    "# Change the number to the desired volume level (0-100).\n"
+                    "\n\r"
+                    "[winmm]\n"
+                    "# Use a real MCI device ID:\n"
+                    "# 0 = old 48879 fake device id, 1 = tries to reserve a real dev id.\n"
+                    "MCIDevID = 1\n\n"
+                    "# Disable accurate seek:\n"
+                    "ACCSeekOFF = 0\n\n"
+                    "# Enable full notify msg support:\n"
+                    "FullNotify = 0\n\n"
+                    "# Enable debug log:\n"
+                    "Log = 0", ogg_winmm_vol);
+        fclose(fp);
+    }
+}
 
+static void plr_device_close()
+{
     if (plr_ev)
     {
         CloseHandle(plr_ev);
@@ -25,25 +949,65 @@ void plr_stop()
 
     if (plr_hwo)
     {
-        waveOutReset(plr_hwo);
-
-        int i;
-        for (i = 0; i < 3; i++)
-        {
-            if (plr_buffers[i] && plr_buffers[i]->dwFlags & WHDR_DONE)
-            {
-                waveOutUnprepareHeader(plr_hwo, plr_buffers[i], sizeof(WAVEHDR));
-                free(plr_buffers[i]->lpData);
-                free(plr_buffers[i]);
-                plr_buffers[i] = NULL;
-            }
-        }
-
         waveOutClose(plr_hwo);
         plr_hwo = NULL;
     }
 }
 
+/* stops playback, the device is only flushed when keep_device is set */
+static void plr_halt(int keep_device)
+{
+    plr_cnt = 0;
+    plr_ended = 0;
+    plr_path[0] = '\0';
+    plr_cached = NULL;
+    plr_loop_start = plr_loop_end = 0;
+
+    plr_close();
+
+    if (plr_hwo)
+    {
+        waveOutReset(plr_hwo);
+
+        plr_reap();
+    }
+
+    if (!keep_device)
+        plr_device_close();
+
+    plr_raw_close(&plr_raw);
+}
+
+void plr_stop()
+{
+    plr_halt(0);
+}
+
+/* Makes plr_pump() return 0 as soon as it would wait, on the device or on the
+   virtual clock, until it is called again with on = 0. The thread pumping is
+   then stopped with the player state intact and plr_stop() can follow. */
+void plr_interrupt(int on)
+{
+    plr_abort = on;
+
+    if (on && plr_ev)
+        SetEvent(plr_ev);
+    if (on && plr_vstep)
+        SetEvent(plr_vstep);
+}
+
+/* holds the queued buffers, plr_pump() then waits until it is resumed */
+void plr_pause(int on)
+{
+    if (!plr_hwo)
+        return;
+
+    if (on)
+        waveOutPause(plr_hwo);
+    else
+        waveOutRestart(plr_hwo);
+}
+
 void plr_volume(int vol)
 {
     if (vol < 0) vol = 0;
@@ -51,46 +1015,257 @@ void plr_volume(int vol)
     plr_vol = vol;
 }
 
+/* decodes the first plr_intro_ms of a track into a pinned cache entry */
+static void plr_intro(const struct decoder *dec, void *h, const char *path)
+{
+    struct plr_cache *c = plr_cache_find(path);
+    ogg_int64_t total;
+    int i, channels;
+    long rate;
+
+    if ((c && c->pinned) || !dec->info(h, &channels, &rate, &total))
+        return;
+
+    for (i = 0, c = NULL; i < PLR_CACHE_ENTRIES && !c; i++)
+        if (!plr_cache[i].pcm)
+            c = &plr_cache[i];
+
+    if (!c)
+        return;
+
+    /* the first block has to come from memory or plr_pump opens the file */
+    DWORD ms = plr_intro_ms > plr_buf_max ? plr_intro_ms : plr_buf_max;
+    ogg_int64_t samples = (ogg_int64_t)ms * rate / 1000;
+    if (samples > total) samples = total;
+
+    DWORD size = (DWORD)samples * channels * 2, filled = 0;
+    char *pcm = malloc(size);
+
+    if (!pcm)
+        return;
+
+    while (filled < size)
+    {
+        long bytes = dec->read(h, pcm + filled, size - filled);
+
+        if (bytes == OV_HOLE)
+            continue;
+
+        if (bytes <= 0)
+            break;
+
+        filled += bytes;
+    }
+
+    snprintf(c->path, sizeof c->path, "%s", path);
+    c->size     = size;
+    c->filled   = filled;
+    c->total    = total;
+    c->channels = channels;
+    c->rate     = rate;
+    c->pinned   = 1;
+    c->pcm      = pcm;
+}
+
 int plr_length(const char *path)
 {
-    OggVorbis_File  vf;
+    if (plr_is_raw(path))
+    {
+        struct plr_raw raw;
+
+        if (!plr_raw_open(&raw, path))
+            return 0;
+
+        int ret = (int)(raw.total / raw.rate);
+        plr_raw_close(&raw);
+        return ret;
+    }
 
-    if (ov_fopen(path, &vf) != 0)
+    struct reader *r = reader_open(path, 0); /* preloaded or packed */
+    struct source src = { r, reader_callbacks };
+    const struct decoder *dec;
+    void *h;
+
+    if (!r && !source_file(&src, path))
+        return 0;
+
+    if (!(dec = decoder_open(&src, &h)))
+    {
+        source_close(&src);
+        reader_close(r);
         return 0;
+    }
+
+    int channels, ret = 0;
+    long rate;
+    ogg_int64_t total;
+
+    if (dec->info(h, &channels, &rate, &total))
+        ret = (int)(total / rate);
+
+    if (plr_intro_ms && ret > 0)
+        plr_intro(dec, h, path);
 
-    int ret = (int)ov_time_total(&vf, -1);
+    if (plr_loop_tags && ret > 0)
+        plr_read_loop(dec, h, path);
 
-    ov_clear(&vf);
+    dec->close(h);
+    reader_close(r);
 
     return ret;
 }
 
+/* Playing the track that was just played again (a notify driven repeat)
+   keeps the device and the decoder, only the queue is flushed and the
+   stream rewound. That is only done when the last play ran to the end of
+   the track, a play that was stopped midway starts over from plr_halt(). */
+static int plr_replay(const char *path)
+{
+    if (!plr_ended || !plr_path[0] || strcmp(plr_path, path) != 0 || (!plr_hwo && !plr_virtual))
+        return 0;
+
+    if (plr_hwo)
+    {
+        waveOutReset(plr_hwo);
+
+        plr_reap();
+    }
+
+    if (plr_dh)
+    {
+        if (plr_dec->seek(plr_dh, 0) != 0)
+            return 0;
+        plr_dec_pos = 0;
+    }
+
+    if (plr_rs)
+        resample_reset(plr_rs);
+
+    plr_pos = 0;
+    plr_start = 0;
+    plr_end = plr_total;
+    plr_cnt = 0;
+    plr_ended = 0;
+    plr_done_us = 0;
+    return 1;
+}
+
 int plr_play(const char *path)
 {
-    plr_stop();
+    plr_volume_override();
 
-    if (ov_fopen(path, &plr_vf) != 0)
-        return 0;
+    if (plr_replay(path))
+        return 1;
+
+    plr_halt(plr_out_rate != 0);
 
-    vorbis_info *vi = ov_info(&plr_vf, -1);
+    int channels;
+    long rate;
 
-    if (!vi)
+    plr_cached = plr_is_raw(path) ? NULL : plr_cache_find(path);
+
+    /* the intro seeds a full cache entry when there is room for one */
+    if (plr_cached && plr_cached->pinned && plr_cache_max)
     {
-        ov_clear(&plr_vf);
-        return 0;
+        struct plr_cache *intro = plr_cached;
+        struct plr_cache *c = plr_cache_new(path, intro->total, intro->channels, intro->rate);
+
+        if (c)
+        {
+            c->filled = intro->filled < c->size ? intro->filled : c->size;
+            memcpy(c->pcm, intro->pcm, c->filled);
+            plr_cached = c;
+        }
+    }
+
+    if (plr_cached)
+    {
+        channels = plr_cached->channels;
+        rate = plr_cached->rate;
+        plr_total = plr_cached->total;
+    }
+    else if (plr_is_raw(path))
+    {
+        if (!plr_raw_open(&plr_raw, path))
+            return 0;
+
+        channels = plr_raw.channels;
+        rate = plr_raw.rate;
+        plr_total = plr_raw.total;
+    }
+    else
+    {
+        if (plr_open(path) != 0)
+            return 0;
+
+        if (!plr_dec->info(plr_dh, &channels, &rate, &plr_total))
+        {
+            plr_close();
+            return 0;
+        }
+
+        plr_cached = plr_cache_new(path, plr_total, channels, rate);
     }
 
+    snprintf(plr_path, sizeof plr_path, "%s", path);
+    plr_pos = 0;
+    plr_dec_pos = 0;
+    plr_start = 0;
+    plr_end = plr_total;
+
     plr_fmt.wFormatTag      = WAVE_FORMAT_PCM;
-    plr_fmt.nChannels       = vi->channels;
-    plr_fmt.nSamplesPerSec  = vi->rate;
+    plr_fmt.nChannels       = channels;
+    plr_fmt.nSamplesPerSec  = rate;
     plr_fmt.wBitsPerSample  = 16;
     plr_fmt.nBlockAlign     = plr_fmt.nChannels * (plr_fmt.wBitsPerSample / 8);
     plr_fmt.nAvgBytesPerSec = plr_fmt.nBlockAlign * plr_fmt.nSamplesPerSec;
     plr_fmt.cbSize          = 0;
 
+    WAVEFORMATEX prev = plr_out;
+    plr_out = plr_fmt;
+
+    if (plr_out_rate && channels <= 2 && (rate != plr_out_rate || channels != 2))
+    {
+        if (!resample_match(plr_rs, channels, rate, plr_out_rate))
+        {
+            resample_free(plr_rs);
+            plr_rs = resample_new(channels, rate, plr_out_rate);
+        }
+    }
+    else
+    {
+        resample_free(plr_rs);
+        plr_rs = NULL;
+    }
+
+    if (plr_rs)
+    {
+        resample_reset(plr_rs);
+        plr_out.nChannels       = 2;
+        plr_out.nSamplesPerSec  = plr_out_rate;
+        plr_out.nBlockAlign     = 4;
+        plr_out.nAvgBytesPerSec = 4 * plr_out_rate;
+    }
+
+    if (plr_virtual)
+    {
+        if (plr_wav && (plr_out.nChannels != plr_wav_fmt.nChannels || plr_out.nSamplesPerSec != plr_wav_fmt.nSamplesPerSec))
+        {
+            fprintf(stderr, "%s: %d channels at %d Hz can not be captured at %d Hz stereo\n",
+                path, (int)plr_out.nChannels, (int)plr_out.nSamplesPerSec, (int)plr_wav_fmt.nSamplesPerSec);
+            plr_stop();
+            return 0;
+        }
+        return 1;
+    }
+
+    if (plr_hwo && memcmp(&prev, &plr_out, sizeof prev) == 0)
+        return 1;
+
+    plr_device_close();
     plr_ev = CreateEvent(NULL, 0, 1, NULL);
 
-    if (waveOutOpen(&plr_hwo, WAVE_MAPPER, &plr_fmt, (DWORD_PTR)plr_ev, 0, CALLBACK_EVENT) != MMSYSERR_NOERROR)
+    if (waveOutOpen(&plr_hwo, WAVE_MAPPER, &plr_out, (DWORD_PTR)plr_ev, 0, CALLBACK_EVENT) != MMSYSERR_NOERROR)
     {
         return 0;
     }
@@ -98,18 +1273,159 @@ int plr_play(const char *path)
     return 1;
 }
 
+/* Plays CD frames start to end (0 for the end of the file) of a file that
+   holds several CUE tracks. When the previous track of the same file ended
+   right at start, decoding simply continues. Otherwise the open stream is
+   seeked to start, so the file is never reopened. */
+int plr_play_range(const char *path, DWORD start, DWORD end)
+{
+    int open = plr_path[0] && strcmp(plr_path, path) == 0 && (plr_hwo || plr_virtual);
+
+    if (!open || !start || plr_pos != (ogg_int64_t)start * plr_fmt.nSamplesPerSec / 75)
+    {
+        if (!plr_play(path))
+            return 0;
+    }
+
+    plr_start = (ogg_int64_t)start * plr_fmt.nSamplesPerSec / 75;
+    plr_end = (ogg_int64_t)end * plr_fmt.nSamplesPerSec / 75;
+
+    if (plr_start > plr_total) plr_start = plr_total;
+    if (!end || plr_end > plr_total) plr_end = plr_total;
+
+    plr_pos = plr_start;
+    return 1;
+}
+
+/* Decoder read that serves the cached part of a track from memory
+   and fills the cache while decoding from the start of the track */
+static long plr_read(char *buf, int len)
+{
+    if (plr_loop_end)
+    {
+        if (plr_pos >= plr_loop_end)
+            plr_pos = plr_loop_start;
+
+        if (len > (plr_loop_end - plr_pos) * plr_fmt.nBlockAlign)
+            len = (int)(plr_loop_end - plr_pos) * plr_fmt.nBlockAlign;
+    }
+
+    if (plr_pos >= plr_end)
+        return 0;
+
+    if (len > (plr_end - plr_pos) * plr_fmt.nBlockAlign)
+        len = (int)(plr_end - plr_pos) * plr_fmt.nBlockAlign;
+
+    if (plr_raw.map)
+    {
+        char *data = plr_raw_at(&plr_raw, plr_pos, &len);
+
+        if (!data)
+            return OV_EINVAL;
+
+        memcpy(buf, data, len);
+        plr_pos += len / plr_fmt.nBlockAlign;
+        return len;
+    }
+
+    DWORD offset = (DWORD)(plr_pos * plr_fmt.nBlockAlign);
+    long bytes;
+
+    if (plr_cached && offset < plr_cached->filled)
+    {
+        bytes = plr_cached->filled - offset;
+        if (bytes > len) bytes = len;
+        memcpy(buf, plr_cached->pcm + offset, bytes);
+        plr_pos += bytes / plr_fmt.nBlockAlign;
+        return bytes;
+    }
+
+    if (!plr_dh)
+    {
+        if (plr_open(plr_path) != 0)
+            return OV_EINVAL;
+        plr_dec_pos = 0;
+    }
+
+    if (plr_dec_pos != plr_pos)
+    {
+        if (plr_dec->seek(plr_dh, plr_pos) != 0)
+            return OV_EINVAL;
+        plr_dec_pos = plr_pos;
+    }
+
+    bytes = plr_dec->read(plr_dh, buf, len);
+
+    if (bytes > 0)
+    {
+        if (plr_cached && offset == plr_cached->filled && plr_cached->filled < plr_cached->size)
+        {
+            DWORD n = plr_cached->size - plr_cached->filled;
+            if (n > bytes) n = bytes;
+            memcpy(plr_cached->pcm + plr_cached->filled, buf, n);
+            plr_cached->filled += n;
+        }
+
+        plr_pos += bytes / plr_fmt.nBlockAlign;
+        plr_dec_pos = plr_pos;
+    }
+
+    return bytes;
+}
+
 int plr_pump()
 {
-    if (!plr_vf.datasource)
+    if (!plr_path[0])
+        return 0;
+
+    if (plr_virtual)
+        plr_vwait();
+
+    if (plr_abort)
         return 0;
 
-    int pos = 0;
-    int bufsize = plr_fmt.nAvgBytesPerSec / 4; /* 250ms (avg at 500ms) should be enough for everyone */
-    char *buf = malloc(bufsize);
+    plr_ended = 0;
+
+    LONGLONG start_us = plr_adaptive ? plr_us() : 0;
+    int pos = 0, mapped = 0;
+    /* 250ms (avg at 500ms) should be enough for everyone, unless a buffering profile says otherwise */
+    int bufsize = plr_virtual ? plr_fmt.nAvgBytesPerSec / 4 : plr_fmt.nAvgBytesPerSec / 1000 * plr_buf_ms;
+    bufsize -= bufsize % plr_fmt.nBlockAlign;
+    char *buf;
+
+    /* a virtual block ends at the limit, so the clock stops right there */
+    if (plr_virtual && plr_vend - plr_vtime < 1000000)
+    {
+        ULONGLONG frames = ((plr_vend - plr_vtime) * plr_fmt.nSamplesPerSec + 999999) / 1000000;
+
+        if (frames < (ULONGLONG)(bufsize / plr_fmt.nBlockAlign))
+            bufsize = (int)frames * plr_fmt.nBlockAlign;
+    }
+
+    /* raw PCM is queued straight from the mapping (copied when not at full volume) */
+    if (plr_raw.map && !plr_virtual && !plr_rs && !plr_loop_end && plr_pos < plr_end)
+    {
+        pos = bufsize - bufsize % plr_fmt.nBlockAlign;
+        if (pos > (plr_end - plr_pos) * plr_fmt.nBlockAlign)
+            pos = (int)(plr_end - plr_pos) * plr_fmt.nBlockAlign;
+
+        if ((buf = plr_raw_at(&plr_raw, plr_pos, &pos)) != NULL)
+        {
+            plr_pos += pos / plr_fmt.nBlockAlign;
+            mapped = 1;
+        }
+        else
+        {
+            pos = 0;
+        }
+    }
+
+    if (!mapped)
+        buf = malloc(bufsize);
 
-    while (pos < bufsize)
+    while (!mapped && pos < bufsize)
     {
-        long bytes = ov_read(&plr_vf, buf + pos, bufsize - pos, 0, 2, 1, NULL);
+        long bytes = plr_read(buf + pos, bufsize - pos);
 
         if (bytes == OV_HOLE)
         {
@@ -134,111 +1450,136 @@ int plr_pump()
         {
             free(buf);
 
-            int i, in_queue = 0;
-            for (i = 0; i < 3; i++)
-            {
-                if (plr_buffers[i] && plr_buffers[i]->dwFlags & WHDR_DONE)
-                {
-                    waveOutUnprepareHeader(plr_hwo, plr_buffers[i], sizeof(WAVEHDR));
-                    free(plr_buffers[i]->lpData);
-                    free(plr_buffers[i]);
-                    plr_buffers[i] = NULL;
-                }
-
-                if (plr_buffers[i])
-                    in_queue++;
-            }
+            int in_queue = plr_reap();
 
-            Sleep(100);
+            /* the last buffers are playing, wake up when one is done so the
+               end of the track is seen at its last sample (and MCI_WAIT or
+               the notify return right then) */
+            if (in_queue && plr_ev)
+                WaitForSingleObject(plr_ev, 100);
 
-            return !(in_queue == 0);
+            plr_ended = in_queue == 0;
+            return !plr_ended;
         }
 
         pos += bytes;
     }
 
-    /* Add volume override with "winmm.ini". */
-    int ogg_winmm_vol = 100;
+    if (plr_ahead && plr_next_path[0] && !plr_next && plr_end - plr_pos < (ogg_int64_t)plr_fmt.nSamplesPerSec * PLR_PREFETCH_SECS)
+        plr_next = reader_open(plr_next_path, plr_ahead);
 
-    FILE * fp;
-    fp = fopen ("winmm.ini", "r");
-            /* If not null read values */
-            if (fp != NULL){
-            fscanf(fp, "%d", &ogg_winmm_vol);
-            fclose(fp);
-            if (ogg_winmm_vol < 0) ogg_winmm_vol = 0;
-            if (ogg_winmm_vol > 100) ogg_winmm_vol = 100;
-            if (ogg_winmm_vol != 100) plr_vol = ogg_winmm_vol;
-        }
-        /* Else write new ini file */
-        else{
-        fp = fopen ("winmm.ini", "w+");
-        fprintf(fp, "%d\n"
-                    "#\n"
-                    "# Winmm.dll emulated CD music volume override.\n"
-                    "# Change the number to the desired volume level (0-100).\n"
-                    "\n\r"
-                    "[winmm]\n"
-                    "# Use a real MCI device ID:\n"
-                    "# 0 = old 48879 fake device id, 1 = tries to reserve a real dev id.\n"
-                    "MCIDevID = 1\n\n"
-                    "# Disable accurate seek:\n"
-                    "ACCSeekOFF = 0\n\n"
-                    "# Enable full notify msg support:\n"
-                    "FullNotify = 0\n\n"
-                    "# Enable debug log:\n"
-                    "Log = 0", ogg_winmm_vol);
-        fclose(fp);
+    if (plr_rs)
+    {
+        char *out = malloc(resample_size(plr_rs, pos / plr_fmt.nBlockAlign));
+        pos = resample(plr_rs, (short *)buf, pos / plr_fmt.nBlockAlign, (short *)out) * plr_out.nBlockAlign;
+        free(buf);
+        buf = out;
     }
 
-    /* volume control, kinda nasty */
+    if (plr_virtual)
+    {
+        plr_gain((short *)buf, (short *)buf, pos / plr_out.nBlockAlign);
+
+        if (plr_wav)
+        {
+            fwrite(buf, pos, 1, plr_wav);
+            plr_wav_bytes += pos;
+        }
 
-    int x, end = pos / 2;
-    short *sbuf = (short *)buf;
-    for (x = 0; x < end; x++)
-        sbuf[x] = sbuf[x] * (plr_vol / 100.0f);
-        
+        plr_vtime += (ULONGLONG)pos * 1000000 / plr_out.nAvgBytesPerSec;
+        free(buf);
+        plr_cnt++;
+        return 1;
+    }
 
-    WAVEHDR *header = malloc(sizeof(WAVEHDR));
-    header->dwBufferLength   = pos;
-    header->lpData           = buf;
-    header->dwUser           = 0;
-    header->dwFlags          = plr_cnt == 0 ? WHDR_BEGINLOOP : 0;
-    header->dwLoops          = 0;
-    header->lpNext           = NULL;
-    header->reserved         = 0;
+    LONGLONG make_us = plr_adaptive ? plr_us() - start_us : 0;
+    int i, queued = plr_reap(), off, len;
+    int sub = plr_late_ms ? plr_out.nAvgBytesPerSec / 1000 * PLR_SUB_MS : pos;
+    int limit = plr_late_ms ? plr_late_cur / PLR_SUB_MS : plr_depth;
 
-    waveOutPrepareHeader(plr_hwo, header, sizeof(WAVEHDR));
+    sub -= sub % plr_out.nBlockAlign;
 
-    if (plr_cnt > 1)
+    if (plr_cnt == 0)
+    {
+        plr_done_us = 0;
+    }
+    else if (plr_adaptive && queued == 0)
     {
-        WaitForSingleObject(plr_ev, INFINITE);
+        /* underrun, the device ran dry before this block was ready */
+        plr_grow();
     }
 
-    int i, queued = 0;
-    for (i = 0; i < 3; i++)
+    for (off = 0; off < pos; off += len)
     {
-        if (plr_buffers[i] && plr_buffers[i]->dwFlags & WHDR_DONE)
+        len = pos - off < sub ? pos - off : sub;
+
+        while (queued >= limit)
         {
-            waveOutUnprepareHeader(plr_hwo, plr_buffers[i], sizeof(WAVEHDR));
-            free(plr_buffers[i]->lpData);
-            free(plr_buffers[i]);
-            plr_buffers[i] = NULL;
+            if (WaitForSingleObject(plr_ev, INFINITE) != WAIT_OBJECT_0)
+                break;
+
+            if (plr_abort)
+            {
+                if (!mapped)
+                    free(buf);
+                return 0;
+            }
+
+            if (plr_adaptive)
+                plr_completed();
+            queued = plr_reap();
+        }
+
+        /* the volume is applied now, in place when the block is queued whole */
+        WAVEHDR *header = malloc(sizeof(WAVEHDR));
+        header->dwBufferLength   = len;
+        header->dwUser           = 0;
+        header->dwFlags          = plr_cnt == 0 && off == 0 ? WHDR_BEGINLOOP : 0;
+        header->dwLoops          = 0;
+        header->lpNext           = NULL;
+        header->reserved         = 0;
+
+        if (mapped && plr_gain_now == PLR_UNITY && plr_gain_target() == PLR_UNITY)
+        {
+            header->lpData = buf + off;
+            header->dwUser = (DWORD_PTR)plr_raw.view;
+            plr_raw.view->refs++;
+        }
+        else if (!mapped && len == pos)
+        {
+            plr_gain((short *)buf, (short *)buf, len / plr_out.nBlockAlign);
+            header->lpData = buf;
+            buf = NULL;
         }
+        else
+        {
+            header->lpData = malloc(len);
+            plr_gain((short *)header->lpData, (short *)(buf + off), len / plr_out.nBlockAlign);
+        }
+
+        waveOutPrepareHeader(plr_hwo, header, sizeof(WAVEHDR));
+
+        for (i = 0; i < PLR_MAX_BUFFERS && plr_buffers[i]; i++);
 
-        if (!queued && plr_buffers[i] == NULL)
+        if (i < PLR_MAX_BUFFERS)
         {
             waveOutWrite(plr_hwo, header, sizeof(WAVEHDR));
+            plr_written_us = plr_us();
             plr_buffers[i] = header;
-            queued = 1;
+            queued++;
+        }
+        else
+        {
+            waveOutUnprepareHeader(plr_hwo, header, sizeof(WAVEHDR));
+            plr_free(header);
         }
     }
 
-    if (!queued)
-    {
-        free(header);
+    if (!mapped)
         free(buf);
-    }
+
+    if (plr_adaptive)
+        plr_adapt(make_us, queued);
 
     plr_cnt++;
 
@@ -247,15 +1588,23 @@ int plr_pump()
 
 int plr_seek(int sec)
 {
-    int len = (int)ov_time_total(&plr_vf, -1);
+    if (!plr_path[0])
+        return -1;
+
+    int len = (int)((plr_end - plr_start) / plr_fmt.nSamplesPerSec);
     if(sec<0) sec=0;
     if(sec > len) sec = len;
-    return ov_time_seek(&plr_vf, (double)sec);
+    plr_pos = plr_start + (ogg_int64_t)sec * plr_fmt.nSamplesPerSec;
+    if (plr_rs) resample_reset(plr_rs);
+    return 0;
 }
 
 int plr_tell()
 {
-    int tpos = (int)ov_time_tell(&plr_vf);
+    if (!plr_path[0])
+        return 0;
+
+    int tpos = (int)((plr_pos - plr_start) / plr_fmt.nSamplesPerSec);
     return tpos;
 }
 
@@ -1,7 +1,31 @@
 void plr_stop();
+void plr_interrupt(int on);
+void plr_pause(int on);
 void plr_volume(int vol);
 int plr_seek(int sec);
 int plr_pump();
 int plr_tell();
 int plr_length(const char *path);
 int plr_play(const char *path);
+extern HANDLE plr_vblock;
+void plr_virtual_clock(int on);
+DWORD plr_time();
+void plr_sleep(DWORD ms);
+void plr_vlimit(DWORD ms);
+void plr_vidle(DWORD ms);
+int plr_capture(const char *path);
+void plr_capture_close();
+void plr_cache_limit(int mb, int secs);
+void plr_warm_start(int ms);
+void plr_use_loop_tags(int on);
+void plr_loop(int on);
+void plr_read_ahead(int kb);
+void plr_prefetch(const char *path);
+DWORD plr_preload(const char **paths, int num);
+const struct pak_header *plr_pak(const char *path, const char *dir);
+int plr_play_range(const char *path, DWORD start, DWORD end);
+void plr_output_rate(int rate);
+void plr_buffering(int profile, int min_ms, int max_ms);
+void plr_volume_latency(int ms);
+LONGLONG plr_us();
+extern LONGLONG plr_written_us;
@@ -0,0 +1,446 @@
+/* Read-ahead file reader: a background thread keeps up to `ahead` bytes past
+   the read position in memory, so a slow disk or network share stalls the
+   I/O thread instead of the decoder and the wave queue. Plugged into
+   vorbisfile through reader_callbacks. */
+
+#ifdef TREMOR
+#include <tremor/ivorbisfile.h>
+#else
+#include <vorbis/vorbisfile.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <windows.h>
+#include "reader.h"
+#include "pak.h"
+
+#define READER_CHUNK (64 * 1024)
+
+/* Preloaded tracks: the encoded files are copied into one pagefile backed
+   mapping, outside of the game's heap. Readers for these files serve the
+   mapping directly and have no I/O thread. */
+struct reader_file
+{
+    char            path[MAX_PATH];
+    DWORD           offset;
+    DWORD           size;
+    const struct pak_seek *seeks;   /* packed tracks, inside the mapping */
+    DWORD           num_seeks;
+};
+
+struct reader_arena
+{
+    HANDLE          mapping;
+    char            *base;
+    LONG            refs;
+    int             num;
+    struct reader_file *files;
+};
+
+static struct reader_arena *reader_arena = NULL;
+
+struct reader
+{
+    char            path[MAX_PATH];
+    struct reader_arena *arena; /* preloaded, buf points into the mapping */
+    const struct pak_seek *seeks;
+    DWORD           num_seeks;
+    HANDLE          file;
+    ULONGLONG       size;
+    char            *buf;
+    DWORD           cap;
+    ULONGLONG       base;       /* file offset of buf[0] */
+    DWORD           len;        /* valid bytes in buf */
+    ULONGLONG       pos;        /* read position of the decoder */
+    int             quit;
+    CRITICAL_SECTION cs;
+    HANDLE          wake;       /* read position moved */
+    HANDLE          ready;      /* more data is available */
+    HANDLE          thread;
+};
+
+/* Only the I/O thread changes base/len and the layout of buf. The decoder
+   reads [pos - base, len) and the I/O thread fills [len, cap), so the copy in
+   and out happens outside the lock. */
+static DWORD WINAPI reader_main(struct reader *r)
+{
+    while (1)
+    {
+        EnterCriticalSection(&r->cs);
+
+        if (r->quit)
+        {
+            LeaveCriticalSection(&r->cs);
+            return 0;
+        }
+
+        /* seek outside of the window, start over at the new position */
+        if (r->pos < r->base || r->pos > r->base + r->len)
+        {
+            r->base = r->pos;
+            r->len = 0;
+        }
+
+        /* drop what has been consumed once it is half the window */
+        DWORD used = (DWORD)(r->pos - r->base);
+        if (used >= r->cap / 2)
+        {
+            memmove(r->buf, r->buf + used, r->len - used);
+            r->base += used;
+            r->len -= used;
+        }
+
+        ULONGLONG offset = r->base + r->len;
+        DWORD want = r->cap - r->len;
+        char *dst = r->buf + r->len;
+
+        if (want > READER_CHUNK)
+            want = READER_CHUNK;
+        if (offset + want > r->size)
+            want = (DWORD)(r->size - offset);
+
+        LeaveCriticalSection(&r->cs);
+
+        if (want == 0)
+        {
+            WaitForSingleObject(r->wake, INFINITE);
+            continue;
+        }
+
+        OVERLAPPED ov;
+        DWORD got = 0;
+        memset(&ov, 0, sizeof ov);
+        ov.Offset = (DWORD)offset;
+        ov.OffsetHigh = (DWORD)(offset >> 32);
+
+        if (!ReadFile(r->file, dst, want, &got, &ov) || got == 0)
+        {
+            /* treat read errors as end of file */
+            EnterCriticalSection(&r->cs);
+            r->size = offset;
+            LeaveCriticalSection(&r->cs);
+            SetEvent(r->ready);
+            continue;
+        }
+
+        EnterCriticalSection(&r->cs);
+        if (r->base + r->len == offset)
+            r->len += got;
+        LeaveCriticalSection(&r->cs);
+
+        SetEvent(r->ready);
+    }
+}
+
+static void reader_arena_release(struct reader_arena *a)
+{
+    if (InterlockedDecrement(&a->refs) > 0)
+        return;
+
+    UnmapViewOfFile(a->base);
+    CloseHandle(a->mapping);
+    free(a->files);
+    free(a);
+}
+
+DWORD reader_preload(const char **paths, int num)
+{
+    struct reader_arena *a = calloc(1, sizeof *a);
+    DWORD total = 0;
+    int i;
+
+    a->refs = 1;
+    a->files = calloc(num > 0 ? num : 1, sizeof *a->files);
+
+    for (i = 0; i < num; i++)
+    {
+        WIN32_FILE_ATTRIBUTE_DATA attr;
+
+        if (!GetFileAttributesEx(paths[i], GetFileExInfoStandard, &attr) || attr.nFileSizeHigh)
+            continue;
+
+        struct reader_file *f = &a->files[a->num++];
+        snprintf(f->path, sizeof f->path, "%s", paths[i]);
+        f->offset = total;
+        f->size = attr.nFileSizeLow;
+        total += f->size;
+    }
+
+    if (total)
+    {
+        a->mapping = CreateFileMapping(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, total, NULL);
+        if (a->mapping)
+            a->base = MapViewOfFile(a->mapping, FILE_MAP_WRITE, 0, 0, total);
+    }
+
+    if (!a->base)
+    {
+        if (a->mapping) CloseHandle(a->mapping);
+        free(a->files);
+        free(a);
+        return 0;
+    }
+
+    for (i = 0; i < a->num; i++)
+    {
+        struct reader_file *f = &a->files[i];
+        HANDLE file = CreateFile(f->path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        DWORD got = 0;
+
+        if (file != INVALID_HANDLE_VALUE)
+        {
+            ReadFile(file, a->base + f->offset, f->size, &got, NULL);
+            CloseHandle(file);
+        }
+
+        /* a file that could not be read is left to the disk readers */
+        if (got != f->size)
+            f->path[0] = '\0';
+    }
+
+    if (reader_arena)
+        reader_arena_release(reader_arena);
+    reader_arena = a;
+
+    return total;
+}
+
+/* Maps a music.pak and serves its tracks as dir\TrackNN.ogg. Returns the
+   header inside the mapping, valid until the next preload or pak. */
+const struct pak_header *reader_pak(const char *path, const char *dir)
+{
+    HANDLE file = CreateFile(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL);
+
+    if (file == INVALID_HANDLE_VALUE)
+        return NULL;
+
+    DWORD high = 0, size = GetFileSize(file, &high);
+    HANDLE mapping = high || size < sizeof(struct pak_header) ? NULL : CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+
+    if (!mapping)
+        return NULL;
+
+    char *base = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    const struct pak_header *hdr = (const struct pak_header *)base;
+    const struct pak_track *toc = (const struct pak_track *)(hdr + 1);
+    DWORD i;
+
+    if (!base || memcmp(hdr->magic, PAK_MAGIC, 4) != 0 || hdr->version != PAK_VERSION || hdr->num_tracks > 99
+        || sizeof *hdr + hdr->num_tracks * sizeof *toc > size)
+        goto fail;
+
+    for (i = 0; i < hdr->num_tracks; i++)
+    {
+        if (toc[i].offset > size || toc[i].size > size - toc[i].offset
+            || toc[i].seek_offset > size || toc[i].seek_count > (size - toc[i].seek_offset) / sizeof(struct pak_seek))
+            goto fail;
+    }
+
+    struct reader_arena *a = calloc(1, sizeof *a);
+
+    a->refs = 1;
+    a->mapping = mapping;
+    a->base = base;
+    a->files = calloc(hdr->num_tracks ? hdr->num_tracks : 1, sizeof *a->files);
+
+    for (i = 0; i < hdr->num_tracks; i++)
+    {
+        struct reader_file *f = &a->files[a->num++];
+        snprintf(f->path, sizeof f->path, "%s\\Track%02u.ogg", dir, (unsigned)toc[i].number);
+        f->offset = toc[i].offset;
+        f->size = toc[i].size;
+        f->seeks = (const struct pak_seek *)(base + toc[i].seek_offset);
+        f->num_seeks = toc[i].seek_count;
+    }
+
+    if (reader_arena)
+        reader_arena_release(reader_arena);
+    reader_arena = a;
+
+    return hdr;
+
+fail:
+    if (base) UnmapViewOfFile(base);
+    CloseHandle(mapping);
+    return NULL;
+}
+
+struct reader *reader_open(const char *path, DWORD ahead)
+{
+    struct reader_arena *a = reader_arena;
+    int i;
+
+    for (i = 0; a && i < a->num; i++)
+    {
+        if (_stricmp(a->files[i].path, path) != 0)
+            continue;
+
+        struct reader *r = calloc(1, sizeof *r);
+
+        snprintf(r->path, sizeof r->path, "%s", path);
+        InterlockedIncrement(&a->refs);
+        r->arena = a;
+        r->buf = a->base + a->files[i].offset;
+        r->size = r->cap = r->len = a->files[i].size;
+        r->seeks = a->files[i].seeks;
+        r->num_seeks = a->files[i].num_seeks;
+        InitializeCriticalSection(&r->cs);
+
+        return r;
+    }
+
+    if (!ahead)
+        return NULL;
+
+    HANDLE file = CreateFile(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+    if (file == INVALID_HANDLE_VALUE)
+        return NULL;
+
+    struct reader *r = calloc(1, sizeof *r);
+    DWORD high = 0;
+
+    if (ahead < READER_CHUNK * 2)
+        ahead = READER_CHUNK * 2;
+
+    r->buf = malloc(ahead);
+
+    if (!r->buf)
+    {
+        CloseHandle(file);
+        free(r);
+        return NULL;
+    }
+
+    snprintf(r->path, sizeof r->path, "%s", path);
+    r->file = file;
+    r->size = GetFileSize(file, &high);
+    r->size |= (ULONGLONG)high << 32;
+    r->cap = ahead;
+
+    InitializeCriticalSection(&r->cs);
+    r->wake = CreateEvent(NULL, 0, 0, NULL);
+    r->ready = CreateEvent(NULL, 0, 0, NULL);
+    r->thread = CreateThread(NULL, 0, (LPTHREAD_START_ROUTINE)reader_main, r, 0, NULL);
+
+    return r;
+}
+
+void reader_close(struct reader *r)
+{
+    if (!r)
+        return;
+
+    if (r->arena)
+    {
+        reader_arena_release(r->arena);
+        DeleteCriticalSection(&r->cs);
+        free(r);
+        return;
+    }
+
+    EnterCriticalSection(&r->cs);
+    r->quit = 1;
+    LeaveCriticalSection(&r->cs);
+    SetEvent(r->wake);
+
+    WaitForSingleObject(r->thread, INFINITE);
+    CloseHandle(r->thread);
+    CloseHandle(r->wake);
+    CloseHandle(r->ready);
+    CloseHandle(r->file);
+    DeleteCriticalSection(&r->cs);
+    free(r->buf);
+    free(r);
+}
+
+const char *reader_path(struct reader *r)
+{
+    return r->path;
+}
+
+/* the page seek table of a track served from a music.pak, NULL otherwise */
+const struct pak_seek *reader_seeks(struct reader *r, DWORD *num)
+{
+    *num = r ? r->num_seeks : 0;
+    return r ? r->seeks : NULL;
+}
+
+static size_t reader_read(void *ptr, size_t size, size_t nmemb, void *datasource)
+{
+    struct reader *r = datasource;
+    size_t want = size * nmemb, got = 0;
+
+    if (want == 0)
+        return 0;
+
+    EnterCriticalSection(&r->cs);
+
+    while (got < want && r->pos < r->size)
+    {
+        if (r->pos >= r->base && r->pos < r->base + r->len)
+        {
+            DWORD avail = (DWORD)(r->base + r->len - r->pos);
+            DWORD n = want - got < avail ? want - got : avail;
+
+            memcpy((char *)ptr + got, r->buf + (r->pos - r->base), n);
+            r->pos += n;
+            got += n;
+            if (r->wake) SetEvent(r->wake);
+        }
+        else
+        {
+            LeaveCriticalSection(&r->cs);
+            SetEvent(r->wake);
+            WaitForSingleObject(r->ready, INFINITE);
+            EnterCriticalSection(&r->cs);
+        }
+    }
+
+    LeaveCriticalSection(&r->cs);
+
+    return got / size;
+}
+
+static int reader_seek(void *datasource, ogg_int64_t offset, int whence)
+{
+    struct reader *r = datasource;
+    ogg_int64_t pos;
+
+    EnterCriticalSection(&r->cs);
+
+    if (whence == SEEK_CUR)
+        pos = r->pos + offset;
+    else if (whence == SEEK_END)
+        pos = r->size + offset;
+    else
+        pos = offset;
+
+    if (pos < 0 || pos > r->size)
+    {
+        LeaveCriticalSection(&r->cs);
+        return -1;
+    }
+
+    r->pos = pos;
+    LeaveCriticalSection(&r->cs);
+    if (r->wake) SetEvent(r->wake);
+
+    return 0;
+}
+
+static int reader_noclose(void *datasource)
+{
+    /* the player closes readers itself so a prefetched one can be handed over */
+    return 0;
+}
+
+static long reader_tell(void *datasource)
+{
+    struct reader *r = datasource;
+    return (long)r->pos;
+}
+
+ov_callbacks reader_callbacks = { reader_read, reader_seek, reader_noclose, reader_tell };
@@ -0,0 +1,12 @@
+/* Read-ahead file reader for the Vorbis decoder (reader.c) */
+
+struct reader;
+
+struct reader *reader_open(const char *path, DWORD ahead);
+DWORD reader_preload(const char **paths, int num);
+const struct pak_header *reader_pak(const char *path, const char *dir);
+void reader_close(struct reader *r);
+const char *reader_path(struct reader *r);
+const struct pak_seek *reader_seeks(struct reader *r, DWORD *num);
+
+extern ov_callbacks reader_callbacks;
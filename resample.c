@@ -0,0 +1,204 @@
+/* Polyphase resampler: converts 16-bit mono or stereo PCM to stereo at a
+   fixed output rate so the wave device can stay open at one format.
+
+   The rate ratio is reduced to out/in = L/M and a windowed sinc low pass of
+   RS_TAPS * L taps at the upsampled rate is split into L phases of RS_TAPS
+   taps. Every output sample is then one RS_TAPS long dot product per
+   channel. The phases are stored reversed and the history is kept per
+   channel as floats, so the dot product runs over two contiguous arrays (SSE
+   when the processor has it, picked at runtime, plain C otherwise). */
+
+#include <windows.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <xmmintrin.h>
+#include "resample.h"
+
+#define RS_TAPS     32          /* per phase, a multiple of 4 */
+#define RS_PHASES   1024        /* larger L (odd rates) are not supported */
+#define RS_CHUNK    4096        /* input frames per pass */
+
+struct resampler
+{
+    int             channels;   /* of the input */
+    int             in_rate;
+    int             out_rate;
+    int             L, M;
+    float           *coefs;     /* L phases of RS_TAPS, reversed */
+    float           *hist[2];   /* RS_TAPS - 1 frames of history, then the input */
+    unsigned int    pos;        /* of the next output sample in 1/L input frames */
+};
+
+static int gcd(int a, int b)
+{
+    while (b)
+    {
+        int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+static float dot_c(const float *c, const float *x)
+{
+    float a = 0, b = 0, d = 0, e = 0;
+    int i;
+
+    for (i = 0; i < RS_TAPS; i += 4)
+    {
+        a += c[i] * x[i];
+        b += c[i + 1] * x[i + 1];
+        d += c[i + 2] * x[i + 2];
+        e += c[i + 3] * x[i + 3];
+    }
+
+    return a + b + d + e;
+}
+
+/* built for SSE whatever the flags, the stack is realigned for the spills */
+static __attribute__((target("sse"), force_align_arg_pointer)) float dot_sse(const float *c, const float *x)
+{
+    __m128 acc = _mm_setzero_ps();
+    float r[4];
+    int i;
+
+    for (i = 0; i < RS_TAPS; i += 4)
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(c + i), _mm_loadu_ps(x + i)));
+
+    _mm_storeu_ps(r, acc);
+    return r[0] + r[1] + r[2] + r[3];
+}
+
+static float (*dot)(const float *c, const float *x) = dot_c;
+
+struct resampler *resample_new(int channels, int in_rate, int out_rate)
+{
+    if (channels < 1 || channels > 2 || in_rate <= 0 || out_rate <= 0)
+        return NULL;
+
+    int g = gcd(in_rate, out_rate);
+    int L = out_rate / g, M = in_rate / g;
+
+    if (L > RS_PHASES)
+        return NULL;
+
+    struct resampler *rs = calloc(1, sizeof *rs);
+
+    if (IsProcessorFeaturePresent(PF_XMMI_INSTRUCTIONS_AVAILABLE))
+        dot = dot_sse;
+
+    rs->channels = channels;
+    rs->in_rate = in_rate;
+    rs->out_rate = out_rate;
+    rs->L = L;
+    rs->M = M;
+    rs->coefs = malloc(sizeof(float) * L * RS_TAPS);
+    rs->hist[0] = calloc(RS_TAPS - 1 + RS_CHUNK, sizeof(float));
+    rs->hist[1] = calloc(RS_TAPS - 1 + RS_CHUNK, sizeof(float));
+
+    /* Blackman windowed sinc, cut off a little below the lower Nyquist */
+    double fc = 0.45 / (L > M ? L : M);
+    double center = (RS_TAPS * L - 1) / 2.0;
+    int p, j;
+
+    for (p = 0; p < L; p++)
+    {
+        double sum = 0;
+
+        for (j = 0; j < RS_TAPS; j++)
+        {
+            int k = p + j * L;
+            double x = k - center;
+            double sinc = x == 0 ? 1.0 : sin(2 * M_PI * fc * x) / (2 * M_PI * fc * x);
+            double w = 0.42 - 0.5 * cos(2 * M_PI * k / (RS_TAPS * L - 1)) + 0.08 * cos(4 * M_PI * k / (RS_TAPS * L - 1));
+
+            rs->coefs[p * RS_TAPS + RS_TAPS - 1 - j] = (float)(sinc * w);
+            sum += sinc * w;
+        }
+
+        /* every phase gets unity gain, no ripple at DC */
+        for (j = 0; j < RS_TAPS; j++)
+            rs->coefs[p * RS_TAPS + j] /= (float)sum;
+    }
+
+    resample_reset(rs);
+    return rs;
+}
+
+void resample_free(struct resampler *rs)
+{
+    if (!rs)
+        return;
+
+    free(rs->coefs);
+    free(rs->hist[0]);
+    free(rs->hist[1]);
+    free(rs);
+}
+
+/* forgets the history after a seek */
+void resample_reset(struct resampler *rs)
+{
+    memset(rs->hist[0], 0, sizeof(float) * (RS_TAPS - 1));
+    memset(rs->hist[1], 0, sizeof(float) * (RS_TAPS - 1));
+    rs->pos = (RS_TAPS - 1) * rs->L;
+}
+
+int resample_match(struct resampler *rs, int channels, int in_rate, int out_rate)
+{
+    return rs && rs->channels == channels && rs->in_rate == in_rate && rs->out_rate == out_rate;
+}
+
+/* bytes of output at most for this many input frames */
+int resample_size(struct resampler *rs, int frames)
+{
+    return (int)(((long long)frames * rs->L + rs->M - 1) / rs->M + 1) * 4;
+}
+
+static short clip(float v)
+{
+    if (v > 32767.0f) return 32767;
+    if (v < -32768.0f) return -32768;
+    return (short)lrintf(v);
+}
+
+/* Converts frames of input, returns the number of stereo frames written. */
+int resample(struct resampler *rs, const short *in, int frames, short *out)
+{
+    const int H = RS_TAPS - 1;
+    int written = 0;
+
+    while (frames > 0)
+    {
+        int n = frames < RS_CHUNK ? frames : RS_CHUNK, i;
+        float *l = rs->hist[0], *r = rs->hist[1];
+
+        for (i = 0; i < n; i++)
+        {
+            l[H + i] = in[i * rs->channels];
+            r[H + i] = in[i * rs->channels + rs->channels - 1];
+        }
+
+        while (rs->pos / rs->L < (unsigned int)(H + n))
+        {
+            const float *c = rs->coefs + (rs->pos % rs->L) * RS_TAPS;
+            int ip = rs->pos / rs->L - H;
+
+            out[written * 2] = clip(dot(c, l + ip));
+            out[written * 2 + 1] = rs->channels == 2 ? clip(dot(c, r + ip)) : out[written * 2];
+            written++;
+            rs->pos += rs->M;
+        }
+
+        memmove(l, l + n, sizeof(float) * H);
+        memmove(r, r + n, sizeof(float) * H);
+        rs->pos -= n * rs->L;
+
+        in += n * rs->channels;
+        frames -= n;
+    }
+
+    return written;
+}
@@ -0,0 +1,10 @@
+/* Polyphase resampler to a fixed output rate (resample.c) */
+
+struct resampler;
+
+struct resampler *resample_new(int channels, int in_rate, int out_rate);
+void resample_free(struct resampler *rs);
+void resample_reset(struct resampler *rs);
+int resample_match(struct resampler *rs, int channels, int in_rate, int out_rate);
+int resample_size(struct resampler *rs, int frames);
+int resample(struct resampler *rs, const short *in, int frames, short *out);
@@ -0,0 +1,514 @@
+/* In-memory sound effects for sndPlaySound and PlaySound.
+
+   The system functions open and parse the WAV file again on every call,
+   which hitches the games that fire them for every click and effect. With
+   SoundCacheKB set, a sound given by file name (and present on disk) or by
+   SND_RESOURCE is parsed once and kept in a hash table, keyed by the full
+   path and last write time of the file or by the module and name of the
+   resource. It is then played from memory on a wave device of a small
+   pool that stays open per format, so a repeated effect costs no disk I/O
+   and no device open.
+
+   Everything else (aliases, SND_MEMORY, the wide char versions, sounds
+   that do not fit in the cache) still goes to the system, which plays one
+   sound at a time per process like these do: starting either kind stops
+   the other. */
+
+#include <windows.h>
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sound.h"
+
+/* generated thunks to the real functions (relay.s) */
+BOOL WINAPI relay_sndPlaySoundA(LPCSTR a0, UINT a1);
+BOOL WINAPI relay_sndPlaySoundW(LPCWSTR a0, UINT a1);
+BOOL WINAPI relay_PlaySound(LPCSTR a0, HMODULE a1, DWORD a2);
+BOOL WINAPI relay_PlaySoundA(LPCSTR a0, HMODULE a1, DWORD a2);
+BOOL WINAPI relay_PlaySoundW(LPCWSTR a0, HMODULE a1, DWORD a2);
+
+#define SOUND_BUCKETS   64
+#define SOUND_DEVICES   4       /* formats kept open at once */
+
+struct sound
+{
+    struct sound    *next;      /* in the bucket */
+    char            *path;      /* full path, NULL for a resource */
+    FILETIME        mtime;
+    HMODULE         module;     /* resource module and name (or id) */
+    char            *name;
+    WORD            id;
+    WAVEFORMATEX    *fmt;
+    char            *data;
+    DWORD           size;
+    DWORD           bytes;      /* charged to the cache */
+};
+
+struct sound_out
+{
+    WAVEFORMATEX    *fmt;
+    HWAVEOUT        hwo;
+    HANDLE          event;
+    WAVEHDR         header;
+    struct sound    *playing;
+};
+
+static struct sound *sound_table[SOUND_BUCKETS];
+static struct sound_out sound_out[SOUND_DEVICES];
+static int sound_next_out = 0;      /* replaced when all are taken */
+static DWORD sound_limit = 0;       /* bytes, 0 when disabled */
+static DWORD sound_used = 0;
+static LONG sound_serial = 0;       /* bumped on every start and stop */
+static int sound_system = 0;        /* the system may be playing one */
+static CRITICAL_SECTION sound_cs;
+
+/* FNV-1a, case insensitive like the file system */
+static DWORD sound_hash(const char *s)
+{
+    DWORD h = 2166136261u;
+
+    while (*s)
+        h = (h ^ (unsigned char)tolower(*s++)) * 16777619u;
+
+    return h % SOUND_BUCKETS;
+}
+
+static void sound_free(struct sound *s)
+{
+    free(s->path);
+    free(s->name);
+    free(s->fmt);
+    free(s->data);
+    free(s);
+}
+
+/* Keeps the format and the samples of a RIFF WAVE image. */
+static struct sound *sound_parse(const char *p, DWORD size)
+{
+    const WAVEFORMATEX *fmt = NULL;
+    DWORD offset = 12, fmt_len = 0;
+
+    if (size < 12 || memcmp(p, "RIFF", 4) != 0 || memcmp(p + 8, "WAVE", 4) != 0)
+        return NULL;
+
+    while (offset + 8 <= size)
+    {
+        DWORD len = *(const DWORD *)(p + offset + 4);
+
+        if (len > size - offset - 8)
+            len = size - offset - 8;
+
+        if (memcmp(p + offset, "fmt ", 4) == 0 && len >= 16)
+        {
+            fmt = (const WAVEFORMATEX *)(p + offset + 8);
+            fmt_len = len;
+        }
+
+        if (memcmp(p + offset, "data", 4) == 0 && fmt && len)
+        {
+            struct sound *s = calloc(1, sizeof *s);
+
+            /* PCM fmt chunks stop before cbSize */
+            s->fmt = calloc(1, fmt_len > sizeof(WAVEFORMATEX) ? fmt_len : sizeof(WAVEFORMATEX));
+            memcpy(s->fmt, fmt, fmt_len);
+            /* the extra bytes cbSize claims have to be in the chunk, the
+               format is compared, copied and opened over all of them */
+            if (fmt_len <= sizeof(WAVEFORMATEX))
+                s->fmt->cbSize = 0;
+            else if (s->fmt->cbSize > fmt_len - sizeof(WAVEFORMATEX))
+                s->fmt->cbSize = (WORD)(fmt_len - sizeof(WAVEFORMATEX));
+
+            s->data = malloc(len);
+            memcpy(s->data, p + offset + 8, len);
+            s->size = len;
+            s->bytes = len + fmt_len + sizeof *s;
+            return s;
+        }
+
+        offset += 8 + len + (len & 1);
+    }
+
+    return NULL;
+}
+
+static void sound_insert(struct sound *s, DWORD bucket)
+{
+    s->next = sound_table[bucket];
+    sound_table[bucket] = s;
+    sound_used += s->bytes;
+}
+
+static int sound_fits(struct sound *s)
+{
+    return sound_used + s->bytes <= sound_limit;
+}
+
+static int sound_is_playing(struct sound_out *out)
+{
+    return out->playing && !(out->header.dwFlags & WHDR_DONE);
+}
+
+static void sound_halt(struct sound_out *out)
+{
+    if (!out->playing)
+        return;
+
+    waveOutReset(out->hwo);
+    waveOutUnprepareHeader(out->hwo, &out->header, sizeof out->header);
+    out->playing = NULL;
+}
+
+/* stops the cached sound, and with system set the one of the system too */
+static void sound_stop(int system)
+{
+    int i;
+
+    for (i = 0; i < SOUND_DEVICES; i++)
+        sound_halt(&sound_out[i]);
+
+    InterlockedIncrement(&sound_serial);
+
+    if (system && sound_system)
+    {
+        relay_PlaySoundA(NULL, NULL, 0);
+        sound_system = 0;
+    }
+}
+
+static int sound_busy()
+{
+    int i;
+
+    for (i = 0; i < SOUND_DEVICES; i++)
+    {
+        if (sound_is_playing(&sound_out[i]))
+            return 1;
+    }
+
+    return 0;
+}
+
+static void sound_forget(struct sound *s)
+{
+    int i;
+
+    for (i = 0; i < SOUND_DEVICES; i++)
+    {
+        if (sound_out[i].playing == s)
+            sound_halt(&sound_out[i]);
+    }
+
+    sound_used -= s->bytes;
+    sound_free(s);
+}
+
+static struct sound *sound_file(const char *name)
+{
+    char path[MAX_PATH];
+    WIN32_FILE_ATTRIBUTE_DATA attr;
+
+    if (!GetFullPathName(name, MAX_PATH, path, NULL) || !GetFileAttributesEx(path, GetFileExInfoStandard, &attr))
+        return NULL;
+
+    if (attr.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY || attr.nFileSizeHigh || attr.nFileSizeLow > sound_limit)
+        return NULL;
+
+    DWORD bucket = sound_hash(path);
+    struct sound **link = &sound_table[bucket], *s;
+
+    for (; (s = *link) != NULL; link = &s->next)
+    {
+        if (!s->path || _stricmp(s->path, path) != 0)
+            continue;
+
+        if (CompareFileTime(&s->mtime, &attr.ftLastWriteTime) == 0)
+            return s;
+
+        /* the file was replaced */
+        *link = s->next;
+        sound_forget(s);
+        break;
+    }
+
+    HANDLE file = CreateFile(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    DWORD size = attr.nFileSizeLow, got = 0;
+    char *buf;
+
+    if (file == INVALID_HANDLE_VALUE)
+        return NULL;
+
+    buf = malloc(size);
+    ReadFile(file, buf, size, &got, NULL);
+    CloseHandle(file);
+
+    s = got == size ? sound_parse(buf, size) : NULL;
+    free(buf);
+
+    if (!s)
+        return NULL;
+
+    if (!sound_fits(s))
+    {
+        sound_free(s);
+        return NULL;
+    }
+
+    s->path = _strdup(path);
+    s->mtime = attr.ftLastWriteTime;
+    sound_insert(s, bucket);
+    return s;
+}
+
+static struct sound *sound_resource(const char *name, HMODULE module)
+{
+    char key[16];
+    DWORD bucket;
+    struct sound *s;
+
+    if (IS_INTRESOURCE(name))
+        snprintf(key, sizeof key, "#%u", (WORD)(ULONG_PTR)name);
+    bucket = sound_hash(IS_INTRESOURCE(name) ? key : name);
+
+    for (s = sound_table[bucket]; s; s = s->next)
+    {
+        if (s->path || s->module != module)
+            continue;
+
+        if (IS_INTRESOURCE(name) ? (!s->name && s->id == (WORD)(ULONG_PTR)name) : (s->name && _stricmp(s->name, name) == 0))
+            return s;
+    }
+
+    HRSRC res = FindResource(module, name, "WAVE");
+    HGLOBAL mem = res ? LoadResource(module, res) : NULL;
+    const char *p = mem ? LockResource(mem) : NULL;
+
+    if (!p || !(s = sound_parse(p, SizeofResource(module, res))))
+        return NULL;
+
+    if (!sound_fits(s))
+    {
+        sound_free(s);
+        return NULL;
+    }
+
+    s->module = module;
+    if (IS_INTRESOURCE(name))
+        s->id = (WORD)(ULONG_PTR)name;
+    else
+        s->name = _strdup(name);
+    sound_insert(s, bucket);
+    return s;
+}
+
+/* a device of the pool open in the format of s */
+static struct sound_out *sound_device(struct sound *s)
+{
+    DWORD fmt_size = sizeof(WAVEFORMATEX) + s->fmt->cbSize;
+    struct sound_out *out;
+    int i;
+
+    for (i = 0; i < SOUND_DEVICES; i++)
+    {
+        out = &sound_out[i];
+        if (out->hwo && out->fmt->cbSize == s->fmt->cbSize && memcmp(out->fmt, s->fmt, fmt_size) == 0)
+            return out;
+    }
+
+    for (i = 0; i < SOUND_DEVICES && sound_out[i].hwo; i++);
+
+    if (i == SOUND_DEVICES)
+    {
+        i = sound_next_out;
+        sound_next_out = (sound_next_out + 1) % SOUND_DEVICES;
+    }
+
+    out = &sound_out[i];
+
+    if (out->hwo)
+    {
+        waveOutClose(out->hwo);
+        out->hwo = NULL;
+        free(out->fmt);
+    }
+
+    if (!out->event)
+        out->event = CreateEvent(NULL, FALSE, FALSE, NULL);
+
+    if (waveOutOpen(&out->hwo, WAVE_MAPPER, s->fmt, (DWORD_PTR)out->event, 0, CALLBACK_EVENT) != MMSYSERR_NOERROR)
+    {
+        out->hwo = NULL;
+        return NULL;
+    }
+
+    out->fmt = malloc(fmt_size);
+    memcpy(out->fmt, s->fmt, fmt_size);
+    return out;
+}
+
+/* Plays a cached sound, returns -1 when the system has to do it. */
+static int sound_play(const char *name, HMODULE module, DWORD flags)
+{
+    struct sound *s;
+    struct sound_out *out;
+
+    /* aliases, SND_MEMORY and looping synchronous sounds are left alone */
+    if (!name || flags & (SND_ALIAS | SND_PURGE))
+        return -1;
+
+    if ((flags & SND_RESOURCE) == SND_RESOURCE)
+        s = sound_resource(name, module);
+    else if (flags & SND_MEMORY || (flags & SND_LOOP && !(flags & SND_ASYNC)))
+        return -1;
+    else
+        s = sound_file(name);
+
+    if (!s)
+        return -1;
+
+    if (flags & SND_NOSTOP && (sound_busy() || sound_system))
+        return FALSE;
+
+    sound_stop(1);
+
+    if (!(out = sound_device(s)))
+        return -1;
+
+    memset(&out->header, 0, sizeof out->header);
+    out->header.lpData = s->data;
+    out->header.dwBufferLength = s->size;
+    if (flags & SND_LOOP)
+    {
+        out->header.dwFlags = WHDR_BEGINLOOP | WHDR_ENDLOOP;
+        out->header.dwLoops = 0xFFFFFFFF;
+    }
+
+    ResetEvent(out->event);
+    waveOutPrepareHeader(out->hwo, &out->header, sizeof out->header);
+    waveOutWrite(out->hwo, &out->header, sizeof out->header);
+    out->playing = s;
+
+    if (flags & SND_ASYNC)
+        return TRUE;
+
+    /* synchronous, until it ends or another call stops or replaces it */
+    LONG serial = sound_serial;
+    WAVEHDR *header = &out->header;
+
+    LeaveCriticalSection(&sound_cs);
+    while (!(header->dwFlags & WHDR_DONE) && serial == sound_serial)
+        WaitForSingleObject(out->event, 100);
+    EnterCriticalSection(&sound_cs);
+
+    return TRUE;
+}
+
+/* the system plays everything sound_play() does not, called locked */
+static BOOL sound_relay(BOOL (WINAPI *relay)(LPCSTR, HMODULE, DWORD), const void *name, HMODULE module, DWORD flags)
+{
+    BOOL ret;
+
+    if (flags & SND_NOSTOP && sound_busy())
+        return FALSE;
+
+    if (!name || !(flags & SND_NOSTOP))
+        sound_stop(0);
+
+    /* a synchronous one must not hold up the others */
+    LeaveCriticalSection(&sound_cs);
+    ret = relay(name, module, flags);
+    EnterCriticalSection(&sound_cs);
+
+    if (name && ret)
+        sound_system = 1;
+
+    return ret;
+}
+
+void sound_cache(int kb)
+{
+    if (sound_limit || kb <= 0)
+        return;
+
+    InitializeCriticalSection(&sound_cs);
+    sound_limit = kb * 1024;
+}
+
+static BOOL sound_call(BOOL (WINAPI *relay)(LPCSTR, HMODULE, DWORD), const char *name, HMODULE module, DWORD flags)
+{
+    int ret;
+
+    EnterCriticalSection(&sound_cs);
+    ret = sound_play(name, module, flags);
+    if (ret < 0)
+        ret = sound_relay(relay, name, module, flags);
+    LeaveCriticalSection(&sound_cs);
+
+    return ret;
+}
+
+/* sndPlaySound is PlaySound without a module, relayed as itself */
+static BOOL WINAPI sound_relay_sndA(LPCSTR name, HMODULE module, DWORD flags)
+{
+    return relay_sndPlaySoundA(name, flags);
+}
+
+static BOOL WINAPI sound_relay_sndW(LPCSTR name, HMODULE module, DWORD flags)
+{
+    return relay_sndPlaySoundW((LPCWSTR)name, flags);
+}
+
+static BOOL WINAPI sound_relay_W(LPCSTR name, HMODULE module, DWORD flags)
+{
+    return relay_PlaySoundW((LPCWSTR)name, module, flags);
+}
+
+BOOL WINAPI fake_sndPlaySoundA(LPCSTR a0, UINT a1)
+{
+    if (!sound_limit)
+        return relay_sndPlaySoundA(a0, a1);
+
+    return sound_call(sound_relay_sndA, a0, NULL, a1);
+}
+
+BOOL WINAPI fake_sndPlaySoundW(LPCWSTR a0, UINT a1)
+{
+    BOOL ret;
+
+    if (!sound_limit)
+        return relay_sndPlaySoundW(a0, a1);
+
+    EnterCriticalSection(&sound_cs);
+    ret = sound_relay(sound_relay_sndW, a0, NULL, a1);
+    LeaveCriticalSection(&sound_cs);
+    return ret;
+}
+
+BOOL WINAPI fake_PlaySound(LPCSTR a0, HMODULE a1, DWORD a2)
+{
+    if (!sound_limit)
+        return relay_PlaySound(a0, a1, a2);
+
+    return sound_call(relay_PlaySound, a0, a1, a2);
+}
+
+BOOL WINAPI fake_PlaySoundA(LPCSTR a0, HMODULE a1, DWORD a2)
+{
+    if (!sound_limit)
+        return relay_PlaySoundA(a0, a1, a2);
+
+    return sound_call(relay_PlaySoundA, a0, a1, a2);
+}
+
+BOOL WINAPI fake_PlaySoundW(LPCWSTR a0, HMODULE a1, DWORD a2)
+{
+    BOOL ret;
+
+    if (!sound_limit)
+        return relay_PlaySoundW(a0, a1, a2);
+
+    EnterCriticalSection(&sound_cs);
+    ret = sound_relay(sound_relay_W, a0, a1, a2);
+    LeaveCriticalSection(&sound_cs);
+    return ret;
+}
@@ -0,0 +1,3 @@
+/* Cached sndPlaySound and PlaySound (sound.c) */
+
+void sound_cache(int kb);
@@ -0,0 +1,143 @@
+/* Native timeGetTime and timer resolution bookkeeping.
+
+   timeGetTime() is called thousands of times per frame by some game loops.
+   With NativeTimer set it is answered in the DLL: from the performance
+   counter, or from the interrupt time the kernel keeps in the shared user
+   data page (the source the real function reads on NT, as cheap as a memory
+   load but only as fine as the timer resolution). Either is calibrated
+   once against the real function, so the values continue where the real
+   ones left off and wrap around at 2^32 ms the same way.
+
+   With TimerPeriod set the resolution is raised once at startup and held,
+   and the game's timeBeginPeriod/timeEndPeriod pairs at or above it are
+   only counted instead of reprogramming the system timer every time. */
+
+#include <windows.h>
+#include "timer.h"
+
+/* generated thunks to the real functions (relay.s) */
+DWORD WINAPI relay_timeGetTime(void);
+MMRESULT WINAPI relay_timeBeginPeriod(UINT uPeriod);
+MMRESULT WINAPI relay_timeEndPeriod(UINT uPeriod);
+
+/* KSYSTEM_TIME at offset 8 of the page mapped at 0x7FFE0000 in every NT process */
+struct ksystem_time
+{
+    ULONG           low;
+    LONG            high1;
+    LONG            high2;
+};
+
+#define INTERRUPT_TIME ((volatile struct ksystem_time *)0x7FFE0008)
+
+static volatile LONG timer_source = TIMER_RELAY;
+static LONGLONG timer_base;     /* counter or interrupt time at calibration */
+static LONGLONG timer_freq;     /* of timer_base in ticks per second */
+static DWORD timer_base_ms;     /* timeGetTime() at calibration */
+
+static UINT timer_period = 0;   /* held by timer_hold_period() */
+static volatile LONG timer_period_refs = 0;
+
+/* 100 ns units, the kernel writes high2, low, high1 in that order */
+static LONGLONG interrupt_time()
+{
+    LONG high;
+    ULONG low;
+
+    do
+    {
+        high = INTERRUPT_TIME->high1;
+        low = INTERRUPT_TIME->low;
+    } while (high != INTERRUPT_TIME->high2);
+
+    return ((LONGLONG)high << 32) | low;
+}
+
+static LONGLONG timer_ticks(LONG source)
+{
+    LARGE_INTEGER now;
+
+    if (source == TIMER_INTERRUPT)
+        return interrupt_time();
+
+    QueryPerformanceCounter(&now);
+    return now.QuadPart;
+}
+
+/* Switches timeGetTime() to a native source. Returns the source in use,
+   the interrupt time is not there on Windows 9x. */
+int timer_native(int source)
+{
+    LARGE_INTEGER freq, now;
+
+    if (source == TIMER_INTERRUPT && (GetVersion() & 0x80000000))
+        source = TIMER_QPC;
+
+    if (source == TIMER_QPC && !QueryPerformanceFrequency(&freq))
+        source = TIMER_RELAY;
+
+    if (source == TIMER_RELAY || timer_source != TIMER_RELAY)
+        return timer_source;
+
+    /* calibrate while still relaying, then publish */
+    if (source == TIMER_INTERRUPT)
+    {
+        timer_freq = 10000000;
+        timer_base = interrupt_time();
+    }
+    else
+    {
+        QueryPerformanceCounter(&now);
+        timer_freq = freq.QuadPart;
+        timer_base = now.QuadPart;
+    }
+    timer_base_ms = relay_timeGetTime();
+
+    InterlockedExchange(&timer_source, source);
+    return source;
+}
+
+DWORD WINAPI fake_timeGetTime(void)
+{
+    LONG source = timer_source;
+
+    if (source == TIMER_RELAY)
+        return relay_timeGetTime();
+
+    /* unsigned arithmetic wraps at 2^32 like the real function */
+    return timer_base_ms + (DWORD)((timer_ticks(source) - timer_base) * 1000 / timer_freq);
+}
+
+/* Raises the timer resolution to period ms for the rest of the process. */
+void timer_hold_period(UINT period)
+{
+    if (timer_period || !period)
+        return;
+
+    if (relay_timeBeginPeriod(period) == TIMERR_NOERROR)
+        timer_period = period;
+}
+
+MMRESULT WINAPI fake_timeBeginPeriod(UINT uPeriod)
+{
+    if (!timer_period || uPeriod < timer_period)
+        return relay_timeBeginPeriod(uPeriod);
+
+    InterlockedIncrement(&timer_period_refs);
+    return TIMERR_NOERROR;
+}
+
+MMRESULT WINAPI fake_timeEndPeriod(UINT uPeriod)
+{
+    if (!timer_period || uPeriod < timer_period)
+        return relay_timeEndPeriod(uPeriod);
+
+    /* an end without a begin, or one begun before the period was held */
+    if (InterlockedDecrement(&timer_period_refs) < 0)
+    {
+        InterlockedIncrement(&timer_period_refs);
+        return relay_timeEndPeriod(uPeriod);
+    }
+
+    return TIMERR_NOERROR;
+}
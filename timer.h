@@ -0,0 +1,8 @@
+/* Native timeGetTime and timer resolution (timer.c) */
+
+#define TIMER_RELAY     0   /* forward to the real winmm.dll */
+#define TIMER_QPC       1   /* performance counter */
+#define TIMER_INTERRUPT 2   /* interrupt time of the shared user data page */
+
+int timer_native(int source);
+void timer_hold_period(UINT period);
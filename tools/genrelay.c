@@ -0,0 +1,279 @@
+/* genrelay - generates the forwarding thunks for the winmm exports
+
+   usage: genrelay ogg-winmm.def relay.s source.c...
+
+   Every `name = fake_name` export of the def file gets a slot in
+   relay_table and an i386 thunk that jumps through it, so a call the DLL
+   does not intercept goes straight to the real winmm.dll with the caller's
+   stack untouched. Exports whose fake_ function is defined in one of the
+   sources are intercepted: they get a `relay_name` thunk instead, with the
+   stdcall decoration taken from the parameter count of the definition, for
+   the emulation to reach the real function.
+
+   The slots start out pointing at a resolver that looks the function up on
+   the first call (relay_lookup() in stubs.c). relay_resolve_all() fills the
+   whole table from the initialization thread. A function the running
+   winmm.dll does not have gets the slot of a stub that returns
+   MMSYSERR_NOTSUPPORTED, popping the stdcall arguments given as `; @bytes`
+   after the export in the def file. Built and run by the Makefile
+   and Make.cmd with the host compiler, it only needs the C library. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#define MAX_EXPORTS 512
+#define MAX_NAME    64
+
+struct export
+{
+    char    name[MAX_NAME];     /* exported as */
+    char    target[MAX_NAME];   /* fake_ function the def points to */
+    int     args;               /* -1 when not intercepted */
+    int     bytes;              /* of the stdcall arguments, -1 when unknown */
+};
+
+static struct export exports[MAX_EXPORTS];
+static int num_exports;
+
+static char *load(const char *path)
+{
+    FILE *fp = fopen(path, "rb");
+    char *data;
+    long size;
+
+    if (!fp)
+        return NULL;
+
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    data = malloc(size + 1);
+    size = fread(data, 1, size, fp);
+    data[size] = '\0';
+    fclose(fp);
+    return data;
+}
+
+static int read_def(const char *path)
+{
+    FILE *fp = fopen(path, "r");
+    char line[256];
+
+    if (!fp)
+        return 0;
+
+    while (fgets(line, sizeof line, fp))
+    {
+        char name[MAX_NAME], target[MAX_NAME];
+        int bytes = -1;
+
+        /* only the renamed exports, not LIBRARY, EXPORTS or the extensions */
+        if (sscanf(line, " %63[A-Za-z0-9_] = %63[A-Za-z0-9_] ; @%d", name, target, &bytes) < 2)
+            continue;
+
+        if (num_exports == MAX_EXPORTS)
+        {
+            fprintf(stderr, "%s: too many exports\n", path);
+            break;
+        }
+
+        strcpy(exports[num_exports].name, name);
+        strcpy(exports[num_exports].target, target);
+        exports[num_exports].args = -1;
+        exports[num_exports].bytes = bytes;
+        num_exports++;
+    }
+
+    fclose(fp);
+    return 1;
+}
+
+/* Counts the parameters of `WINAPI target(...)` in a source file, -1 when
+   the function is not there. winmm only takes 32-bit arguments. */
+static int count_args(const char *src, const char *target)
+{
+    char pattern[MAX_NAME + 16];
+    const char *p = src;
+    size_t len;
+
+    snprintf(pattern, sizeof pattern, "WINAPI %s", target);
+    len = strlen(pattern);
+
+    while ((p = strstr(p, pattern)) != NULL)
+    {
+        const char *q = p + len;
+        int args = 0, empty = 1;
+
+        p = q;
+        while (isspace((unsigned char)*q))
+            q++;
+        if (*q != '(')
+            continue;
+
+        for (q++; isspace((unsigned char)*q); q++);
+        if (strncmp(q, "void", 4) == 0 && !isalnum((unsigned char)q[4]) && q[4] != '_')
+            return 0;
+
+        for (; *q && *q != ')'; q++)
+        {
+            if (*q == ',')
+                args++;
+            else if (!isspace((unsigned char)*q))
+                empty = 0;
+        }
+
+        if (!empty)
+            args++;
+
+        return args;
+    }
+
+    return -1;
+}
+
+static void write_thunks(FILE *out)
+{
+    int i;
+
+    fprintf(out, "/* generated by genrelay from ogg-winmm.def, do not edit */\n\n");
+    fprintf(out, "    .text\n");
+
+    for (i = 0; i < num_exports; i++)
+    {
+        struct export *e = &exports[i];
+
+        fprintf(out, "    .p2align 2\n");
+        if (e->args < 0)
+        {
+            fprintf(out, "    .globl _%s\n", e->target);
+            fprintf(out, "_%s:\n", e->target);
+        }
+        else
+        {
+            fprintf(out, "    .globl _relay_%s@%d\n", e->name, e->args * 4);
+            fprintf(out, "_relay_%s@%d:\n", e->name, e->args * 4);
+        }
+        fprintf(out, "    jmp *_relay_table+%d\n", i * 4);
+    }
+
+    /* first call of a slot: look it up, then continue into the real function */
+    fprintf(out, "\n");
+    for (i = 0; i < num_exports; i++)
+    {
+        fprintf(out, "relay_lazy_%d:\n", i);
+        fprintf(out, "    pushl $%d\n", i);
+        fprintf(out, "    jmp relay_resolve\n");
+    }
+
+    fprintf(out, "\nrelay_resolve:\n");
+    fprintf(out, "    call _relay_lookup\n");
+    fprintf(out, "    addl $4, %%esp\n");
+    fprintf(out, "    jmp *%%eax\n");
+
+    /* functions missing from the real dll return MMSYSERR_NOTSUPPORTED */
+    fprintf(out, "\n");
+    for (i = 0; i < num_exports; i++)
+    {
+        fprintf(out, "relay_missing_%d:\n", i);
+        fprintf(out, "    movl $8, %%eax\n");
+        fprintf(out, "    ret $%d\n", exports[i].bytes);
+    }
+
+    fprintf(out, "\n    .data\n");
+    fprintf(out, "    .p2align 2\n");
+    fprintf(out, "    .globl _relay_table\n");
+    fprintf(out, "_relay_table:\n");
+    for (i = 0; i < num_exports; i++)
+        fprintf(out, "    .long relay_lazy_%d\n", i);
+
+    fprintf(out, "\n    .section .rdata,\"dr\"\n");
+    fprintf(out, "    .p2align 2\n");
+    fprintf(out, "    .globl _relay_count\n");
+    fprintf(out, "_relay_count:\n");
+    fprintf(out, "    .long %d\n", num_exports);
+    fprintf(out, "    .globl _relay_missing\n");
+    fprintf(out, "_relay_missing:\n");
+    for (i = 0; i < num_exports; i++)
+        fprintf(out, "    .long relay_missing_%d\n", i);
+    fprintf(out, "    .globl _relay_names\n");
+    fprintf(out, "_relay_names:\n");
+    for (i = 0; i < num_exports; i++)
+        fprintf(out, "    .long relay_name_%d\n", i);
+    for (i = 0; i < num_exports; i++)
+        fprintf(out, "relay_name_%d:\n    .asciz \"%s\"\n", i, exports[i].name);
+}
+
+int main(int argc, char **argv)
+{
+    FILE *out;
+    int i, j;
+
+    if (argc < 3)
+    {
+        printf("usage: genrelay ogg-winmm.def relay.s source.c...\n");
+        return 1;
+    }
+
+    if (!read_def(argv[1]))
+    {
+        fprintf(stderr, "%s: could not read\n", argv[1]);
+        return 1;
+    }
+
+    for (i = 3; i < argc; i++)
+    {
+        char *src = load(argv[i]);
+
+        if (!src)
+        {
+            fprintf(stderr, "%s: could not read\n", argv[i]);
+            return 1;
+        }
+
+        for (j = 0; j < num_exports; j++)
+        {
+            int args = count_args(src, exports[j].target);
+
+            if (args >= 0)
+                exports[j].args = args;
+        }
+
+        free(src);
+    }
+
+    for (j = 0; j < num_exports; j++)
+    {
+        struct export *e = &exports[j];
+
+        if (e->args >= 0 && e->bytes >= 0 && e->bytes != e->args * 4)
+            fprintf(stderr, "%s: %s takes %d bytes, %s %d\n", argv[1], e->name, e->bytes, e->target, e->args * 4);
+
+        if (e->args >= 0)
+            e->bytes = e->args * 4;
+
+        if (e->bytes < 0)
+        {
+            fprintf(stderr, "%s: no argument size for %s\n", argv[1], e->name);
+            return 1;
+        }
+    }
+
+    if (!(out = fopen(argv[2], "w")))
+    {
+        fprintf(stderr, "%s: could not write\n", argv[2]);
+        return 1;
+    }
+
+    write_thunks(out);
+
+    if (fclose(out) != 0)
+    {
+        remove(argv[2]);
+        return 1;
+    }
+
+    return 0;
+}
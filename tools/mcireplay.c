@@ -0,0 +1,435 @@
+/* mcireplay - feeds an MCI trace (winmm.trc, Trace = 1 in winmm.ini) back
+   into an ogg-winmm build and reports command latencies, results that
+   differ from the recording and the order of the notify messages.
+
+   usage: mcireplay [-fast] winmm.trc [path\to\winmm.dll]
+
+   Commands are replayed from a single thread in recorded order, at the
+   recorded pace unless -fast is given. */
+
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "../trace.h"
+
+typedef MCIERROR (WINAPI *SENDCOMMAND)(MCIDEVICEID, UINT, DWORD_PTR, DWORD_PTR);
+typedef MCIERROR (WINAPI *SENDSTRING)(LPCSTR, LPSTR, UINT, HWND);
+
+#define MAX_NOTIFY 4096
+
+struct notify
+{
+    DWORD status;
+    DWORD device;
+};
+
+static struct notify expected[MAX_NOTIFY];
+static struct notify received[MAX_NOTIFY];
+static int num_expected = 0;
+static int num_received = 0;
+
+struct latency
+{
+    const char *name;
+    int count;
+    ULONGLONG total;
+    ULONGLONG recorded;
+    DWORD max;
+};
+
+static struct latency stats[32];
+static int num_stats = 0;
+
+static LARGE_INTEGER freq;
+static LARGE_INTEGER start;
+
+static ULONGLONG now_us()
+{
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+
+    ULONGLONG ticks = now.QuadPart - start.QuadPart;
+    return ticks / freq.QuadPart * 1000000 + ticks % freq.QuadPart * 1000000 / freq.QuadPart;
+}
+
+static LRESULT CALLBACK wnd_proc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
+{
+    if (msg == MM_MCINOTIFY && num_received < MAX_NOTIFY)
+    {
+        received[num_received].status = wParam;
+        received[num_received].device = lParam;
+        num_received++;
+        return 0;
+    }
+
+    return DefWindowProcA(hwnd, msg, wParam, lParam);
+}
+
+/* deliver notify messages, optionally until the replay clock reaches `until` */
+static void pump(ULONGLONG until)
+{
+    MSG msg;
+
+    do
+    {
+        while (PeekMessageA(&msg, NULL, 0, 0, PM_REMOVE))
+        {
+            TranslateMessage(&msg);
+            DispatchMessageA(&msg);
+        }
+
+        ULONGLONG now = now_us();
+        if (now >= until)
+            break;
+
+        MsgWaitForMultipleObjects(0, NULL, FALSE, (DWORD)((until - now + 999) / 1000), QS_ALLINPUT);
+    }
+    while (1);
+}
+
+static const char *command_name(UINT msg)
+{
+    switch (msg)
+    {
+        case MCI_OPEN:          return "MCI_OPEN";
+        case MCI_CLOSE:         return "MCI_CLOSE";
+        case MCI_PLAY:          return "MCI_PLAY";
+        case MCI_SEEK:          return "MCI_SEEK";
+        case MCI_STOP:          return "MCI_STOP";
+        case MCI_PAUSE:         return "MCI_PAUSE";
+        case MCI_INFO:          return "MCI_INFO";
+        case MCI_GETDEVCAPS:    return "MCI_GETDEVCAPS";
+        case MCI_SYSINFO:       return "MCI_SYSINFO";
+        case MCI_SET:           return "MCI_SET";
+        case MCI_STATUS:        return "MCI_STATUS";
+        default:                return "other command";
+    }
+}
+
+/* string commands are grouped by their verb */
+static const char *string_name(const char *cmd, int len)
+{
+    static const char *verbs[] = { "open", "close", "play", "seek", "stop", "pause", "status", "set", "info", "capability", "sysinfo", NULL };
+    int i;
+
+    for (i = 0; verbs[i]; i++)
+    {
+        int n = strlen(verbs[i]);
+        if (len >= n && _strnicmp(cmd, verbs[i], n) == 0)
+            return verbs[i];
+    }
+
+    return "other string";
+}
+
+static void add_stat(const char *name, DWORD elapsed, DWORD recorded)
+{
+    int i;
+
+    for (i = 0; i < num_stats; i++)
+        if (stats[i].name == name)
+            break;
+
+    if (i == num_stats)
+    {
+        if (num_stats == sizeof stats / sizeof stats[0])
+            return;
+
+        memset(&stats[i], 0, sizeof stats[i]);
+        stats[i].name = name;
+        num_stats++;
+    }
+
+    stats[i].count++;
+    stats[i].total += elapsed;
+    stats[i].recorded += recorded;
+    if (elapsed > stats[i].max)
+        stats[i].max = elapsed;
+}
+
+/* Device IDs are handed out again by the replay (a reserved waveaudio ID
+   with MCIDevID = 1 differs between runs), the recorded ones are
+   translated to the ones the replayed opens returned. */
+#define MAX_DEVICES 32
+
+static struct { MCIDEVICEID recorded, replayed; } devices[MAX_DEVICES];
+static int num_devices = 0;
+
+static void map_device(MCIDEVICEID recorded, MCIDEVICEID replayed)
+{
+    int i;
+
+    for (i = 0; i < num_devices; i++)
+        if (devices[i].recorded == recorded)
+            break;
+
+    if (i == num_devices)
+    {
+        if (num_devices == MAX_DEVICES)
+            return;
+        num_devices++;
+    }
+
+    devices[i].recorded = recorded;
+    devices[i].replayed = replayed;
+}
+
+static MCIDEVICEID replayed_device(MCIDEVICEID recorded)
+{
+    int i;
+
+    for (i = 0; i < num_devices; i++)
+        if (devices[i].recorded == recorded)
+            return devices[i].replayed;
+
+    return recorded;
+}
+
+/* copies a length prefixed string out of the payload */
+static const BYTE *get_str(const BYTE *p, char *out, int size)
+{
+    WORD len = *(const WORD *)p;
+    int n = len < size ? len : size - 1;
+
+    memcpy(out, p + 2, n);
+    out[n] = '\0';
+
+    return p + 2 + len;
+}
+
+int main(int argc, char **argv)
+{
+    int fast = 0, arg = 1;
+
+    if (argc > arg && strcmp(argv[arg], "-fast") == 0)
+    {
+        fast = 1;
+        arg++;
+    }
+
+    if (argc <= arg)
+    {
+        printf("usage: mcireplay [-fast] winmm.trc [path\\to\\winmm.dll]\n");
+        return 1;
+    }
+
+    const char *trace_path = argv[arg];
+    const char *dll_path = argc > arg + 1 ? argv[arg + 1] : ".\\winmm.dll";
+
+    FILE *fp = fopen(trace_path, "rb");
+    if (!fp)
+    {
+        printf("Could not open %s\n", trace_path);
+        return 1;
+    }
+
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    BYTE *data = malloc(size);
+    fread(data, 1, size, fp);
+    fclose(fp);
+
+    struct trace_header *hdr = (void *)data;
+    if (size < sizeof *hdr || hdr->magic != TRACE_MAGIC || hdr->version != TRACE_VERSION)
+    {
+        printf("%s is not an ogg-winmm trace\n", trace_path);
+        return 1;
+    }
+
+    HMODULE dll = LoadLibrary(dll_path);
+    if (!dll)
+    {
+        printf("Could not load %s\n", dll_path);
+        return 1;
+    }
+
+    SENDCOMMAND send_command = (SENDCOMMAND)GetProcAddress(dll, "mciSendCommandA");
+    SENDSTRING send_string = (SENDSTRING)GetProcAddress(dll, "mciSendStringA");
+
+    WNDCLASSA wc;
+    memset(&wc, 0, sizeof wc);
+    wc.lpfnWndProc = wnd_proc;
+    wc.hInstance = GetModuleHandle(NULL);
+    wc.lpszClassName = "mcireplay";
+    RegisterClassA(&wc);
+
+    /* notify messages are broadcast, so this has to be a top level window */
+    HWND hwnd = CreateWindowExA(0, "mcireplay", "mcireplay", 0, 0, 0, 0, 0, NULL, NULL, wc.hInstance, NULL);
+
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&start);
+
+    const BYTE *p = data + sizeof *hdr;
+    const BYTE *end = data + size;
+    int num = 0, diverged = 0;
+    DWORD threads[16];
+    int num_threads = 0;
+    ULONGLONG first = 0, last = 0;
+
+    while (p + sizeof(struct trace_record) <= end)
+    {
+        const struct trace_record *rec = (const void *)p;
+        const BYTE *payload = p + sizeof *rec;
+        p = payload + rec->size;
+
+        if (p > end)
+            break;
+
+        if (num == 0)
+            first = rec->time;
+        last = rec->time;
+        num++;
+
+        int i;
+        for (i = 0; i < num_threads; i++)
+            if (threads[i] == rec->thread)
+                break;
+        if (i == num_threads && num_threads < 16)
+            threads[num_threads++] = rec->thread;
+
+        if (rec->type == TRACE_NOTIFY)
+        {
+            const struct trace_notify *ntf = (const void *)payload;
+            if (num_expected < MAX_NOTIFY)
+            {
+                expected[num_expected].status = ntf->status;
+                expected[num_expected].device = ntf->device;
+                num_expected++;
+            }
+            continue;
+        }
+
+        pump(fast ? 0 : rec->time - first);
+
+        if (rec->type == TRACE_COMMAND)
+        {
+            const struct trace_command *cmd = (const void *)payload;
+            const BYTE *q = payload + sizeof *cmd;
+            DWORD_PTR words[16];
+            char type[MAX_PATH], element[MAX_PATH], alias[MAX_PATH], expect_ret[1024], ret[1024];
+
+            memset(words, 0, sizeof words);
+            for (i = 0; i < cmd->words && i < 16; i++)
+                words[i] = ((const DWORD *)q)[i];
+            q += cmd->words * sizeof(DWORD);
+
+            if (cmd->flags & MCI_NOTIFY)
+                words[0] = (DWORD_PTR)hwnd;
+
+            ret[0] = expect_ret[0] = '\0';
+
+            if (cmd->has_parms && cmd->msg == MCI_OPEN)
+            {
+                q = get_str(q, type, sizeof type);
+                q = get_str(q, element, sizeof element);
+                q = get_str(q, alias, sizeof alias);
+                if (type[0]) words[2] = (DWORD_PTR)type;
+                if (element[0]) words[3] = (DWORD_PTR)element;
+                if (alias[0]) words[4] = (DWORD_PTR)alias;
+            }
+            else if (cmd->has_parms && (cmd->msg == MCI_INFO || cmd->msg == MCI_SYSINFO))
+            {
+                q = get_str(q, expect_ret, sizeof expect_ret);
+                words[1] = (DWORD_PTR)ret;
+                if (words[2] > sizeof ret)
+                    words[2] = sizeof ret;
+            }
+
+            DWORD expect_return = words[1];
+
+            ULONGLONG t = now_us();
+            MCIERROR result = send_command(replayed_device(cmd->device), cmd->msg, cmd->flags, cmd->has_parms ? (DWORD_PTR)words : 0);
+            DWORD elapsed = (DWORD)(now_us() - t);
+
+            /* the recorded parameters hold the ID the open returned */
+            if (cmd->msg == MCI_OPEN && cmd->has_parms && result == 0 && cmd->result == 0)
+                map_device((MCIDEVICEID)expect_return, (MCIDEVICEID)words[1]);
+
+            add_stat(command_name(cmd->msg), elapsed, rec->elapsed);
+
+            if (result != cmd->result)
+            {
+                printf("#%d %s: returned %u, recorded %u\n", num, command_name(cmd->msg), result, cmd->result);
+                diverged++;
+            }
+            else if ((cmd->msg == MCI_STATUS || cmd->msg == MCI_GETDEVCAPS) && cmd->has_parms && words[1] != expect_return)
+            {
+                printf("#%d %s: dwReturn %u, recorded %u\n", num, command_name(cmd->msg), (DWORD)words[1], expect_return);
+                diverged++;
+            }
+            else if ((cmd->msg == MCI_INFO || cmd->msg == MCI_SYSINFO) && strcmp(ret, expect_ret) != 0)
+            {
+                printf("#%d %s: returned \"%s\", recorded \"%s\"\n", num, command_name(cmd->msg), ret, expect_ret);
+                diverged++;
+            }
+        }
+        else if (rec->type == TRACE_STRING)
+        {
+            const struct trace_string *str = (const void *)payload;
+            char cmd[1024], expect_ret[1024], ret[1024];
+            const BYTE *q = payload + sizeof *str;
+
+            q = get_str(q, cmd, sizeof cmd);
+            q = get_str(q, expect_ret, sizeof expect_ret);
+
+            UINT ret_size = str->ret_size < sizeof ret ? str->ret_size : sizeof ret;
+            ret[0] = '\0';
+
+            ULONGLONG t = now_us();
+            MCIERROR result = send_string(cmd, ret_size ? ret : NULL, ret_size, hwnd);
+            DWORD elapsed = (DWORD)(now_us() - t);
+
+            add_stat(string_name(cmd, strlen(cmd)), elapsed, rec->elapsed);
+
+            if (result != str->result)
+            {
+                printf("#%d \"%s\": returned %u, recorded %u\n", num, cmd, result, str->result);
+                diverged++;
+            }
+            else if (result == 0 && _strnicmp(cmd, "open", 4) == 0 && atoi(ret) && atoi(expect_ret))
+            {
+                /* an open returns the device ID */
+                map_device((MCIDEVICEID)atoi(expect_ret), (MCIDEVICEID)atoi(ret));
+            }
+            else if (ret_size && strcmp(ret, expect_ret) != 0)
+            {
+                printf("#%d \"%s\": returned \"%s\", recorded \"%s\"\n", num, cmd, ret, expect_ret);
+                diverged++;
+            }
+        }
+    }
+
+    /* give the player the rest of the recording to send its notify messages */
+    pump(fast ? now_us() + 500000 : last - first + 500000);
+
+    printf("\n%d records from %d thread(s), %.3f s recorded, %.3f s replayed%s\n",
+        num, num_threads, (last - first) / 1000000.0, now_us() / 1000000.0, fast ? " (fast)" : "");
+    printf("%d result(s) differ from the recording\n\n", diverged);
+
+    printf("%-16s %8s %12s %12s %12s\n", "command", "count", "avg us", "max us", "recorded us");
+    int i;
+    for (i = 0; i < num_stats; i++)
+    {
+        printf("%-16s %8d %12.1f %12u %12.1f\n", stats[i].name, stats[i].count,
+            (double)stats[i].total / stats[i].count, stats[i].max, (double)stats[i].recorded / stats[i].count);
+    }
+
+    printf("\nnotify messages: %d recorded, %d received\n", num_expected, num_received);
+    for (i = 0; i < num_expected && i < num_received; i++)
+    {
+        if (expected[i].status != received[i].status)
+        {
+            printf("notify #%d is %u, recorded %u\n", i + 1, received[i].status, expected[i].status);
+            diverged++;
+            break;
+        }
+    }
+
+    DestroyWindow(hwnd);
+    FreeLibrary(dll);
+    free(data);
+
+    return diverged || num_expected != num_received;
+}
@@ -0,0 +1,118 @@
+/* oggbench - measures how much CPU the track decoders need
+
+   usage: oggbench [-passes n] file...
+
+   Every file is decoded start to end n times (3 by default) with the same
+   decoders the DLL uses and the best pass is reported as CPU cycles and CPU
+   time per second of audio. `make tools` builds oggbench.exe against
+   libvorbisfile and oggbench-tremor.exe against Tremor, run both on the
+   same files to compare them. */
+
+#ifdef TREMOR
+#include <tremor/ivorbisfile.h>
+#else
+#include <vorbis/vorbisfile.h>
+#endif
+#include <windows.h>
+#include <x86intrin.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../decoder.h"
+
+static double cpu_seconds()
+{
+    FILETIME create, exit, kernel, user;
+    GetThreadTimes(GetCurrentThread(), &create, &exit, &kernel, &user);
+
+    ULONGLONG k = ((ULONGLONG)kernel.dwHighDateTime << 32) | kernel.dwLowDateTime;
+    ULONGLONG u = ((ULONGLONG)user.dwHighDateTime << 32) | user.dwLowDateTime;
+
+    return (k + u) / 10000000.0;
+}
+
+int main(int argc, char **argv)
+{
+    int passes = 3, arg = 1, failed = 0;
+    static char buf[65536];
+
+    if (argc > arg + 1 && strcmp(argv[arg], "-passes") == 0)
+    {
+        passes = atoi(argv[arg + 1]);
+        arg += 2;
+    }
+
+    if (argc - arg < 1 || passes < 1)
+    {
+        printf("usage: oggbench [-passes n] file...\n");
+        return 1;
+    }
+
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_HIGHEST);
+
+    for (; arg < argc; arg++)
+    {
+        double best_cycles = 0, best_cpu = 0, seconds = 0;
+        const char *name = NULL;
+        int channels = 0, pass;
+        long rate = 0;
+
+        for (pass = 0; pass < passes; pass++)
+        {
+            struct source src;
+            const struct decoder *dec;
+            void *h;
+            ogg_int64_t total, bytes = 0;
+
+            if (!source_file(&src, argv[arg]))
+                break;
+
+            if (!(dec = decoder_open(&src, &h)))
+            {
+                source_close(&src);
+                break;
+            }
+
+            dec->info(h, &channels, &rate, &total);
+            name = dec->name;
+
+            double cpu = cpu_seconds();
+            unsigned long long cycles = __rdtsc();
+            long got;
+
+            while ((got = dec->read(h, buf, sizeof buf)) != 0)
+            {
+                if (got == OV_HOLE)
+                    continue;
+                if (got < 0)
+                    break;
+                bytes += got;
+            }
+
+            cycles = __rdtsc() - cycles;
+            cpu = cpu_seconds() - cpu;
+            dec->close(h);
+
+            seconds = (double)bytes / (channels * 2) / rate;
+
+            if (pass == 0 || cycles < best_cycles)
+            {
+                best_cycles = cycles;
+                best_cpu = cpu;
+            }
+        }
+
+        if (pass < passes || seconds <= 0)
+        {
+            printf("%s: could not decode\n", argv[arg]);
+            failed++;
+            continue;
+        }
+
+        printf("%s: %s, %ld Hz, %d channels, %.1f s\n", argv[arg], name, rate, channels, seconds);
+        printf("    %.2f Mcycles and %.2f ms CPU per second of audio (%.0fx real time)\n",
+            best_cycles / seconds / 1e6, best_cpu * 1000 / seconds, best_cpu > 0 ? seconds / best_cpu : 0);
+    }
+
+    return failed != 0;
+}
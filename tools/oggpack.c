@@ -0,0 +1,249 @@
+/* oggpack - packs the TrackNN.ogg files of a music folder into music.pak
+
+   usage: oggpack [-interval ms] music_dir [out.pak]
+
+   The pak holds the track lengths and CD positions the DLL would otherwise
+   probe every track for, plus a table of page offsets every `interval` ms
+   (1000 by default) for each track. Without out.pak it is written as
+   music_dir\music.pak, where ogg-winmm looks for it. */
+
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../pak.h"
+
+#define MAX_TRACKS 99
+
+struct track
+{
+    struct pak_track    info;
+    struct pak_seek     *seek;
+    char                *data;
+};
+
+static DWORD le32(const unsigned char *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((DWORD)p[3] << 24);
+}
+
+/* Walks the Ogg pages of a single Vorbis stream: the identification header
+   gives the format, the granule positions the length and the seek table. */
+static int parse(struct track *t, DWORD interval)
+{
+    const unsigned char *p = (const unsigned char *)t->data;
+    DWORD size = t->info.size, offset = 0, max = 0;
+    ULONGLONG mark = 0;
+
+    while (offset + 27 <= size)
+    {
+        const unsigned char *page = p + offset;
+
+        if (memcmp(page, "OggS", 4) != 0)
+            return 0;
+
+        DWORD segments = page[26], body = 0, i;
+
+        if (offset + 27 + segments > size)
+            return 0;
+
+        for (i = 0; i < segments; i++)
+            body += page[27 + i];
+
+        DWORD header = 27 + segments;
+
+        if (offset + header + body > size)
+            return 0;
+
+        ULONGLONG granule = le32(page + 6) | (ULONGLONG)le32(page + 10) << 32;
+
+        if (offset == 0)
+        {
+            const unsigned char *id = page + header;
+
+            if (body < 30 || memcmp(id, "\x01vorbis", 7) != 0)
+                return 0;
+
+            t->info.codec = PAK_VORBIS;
+            t->info.channels = id[11];
+            t->info.rate = le32(id + 12);
+
+            if (!t->info.channels || !t->info.rate)
+                return 0;
+        }
+        else if (granule != (ULONGLONG)-1)
+        {
+            if (granule >= mark)
+            {
+                if (t->info.seek_count == max)
+                {
+                    max = max ? max * 2 : 256;
+                    t->seek = realloc(t->seek, max * sizeof *t->seek);
+                }
+
+                t->seek[t->info.seek_count].granule = granule;
+                t->seek[t->info.seek_count].offset = offset;
+                t->info.seek_count++;
+
+                mark = granule - granule % ((ULONGLONG)t->info.rate * interval / 1000) + (ULONGLONG)t->info.rate * interval / 1000;
+            }
+
+            t->info.samples = granule;
+        }
+
+        offset += header + body;
+    }
+
+    t->info.length = (DWORD)(t->info.samples / t->info.rate);
+    return t->info.codec != 0;
+}
+
+static char *read_file(const char *path, DWORD *size)
+{
+    FILE *fp = fopen(path, "rb");
+
+    if (!fp)
+        return NULL;
+
+    fseek(fp, 0, SEEK_END);
+    long len = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    char *data = len > 0 ? malloc(len) : NULL;
+
+    if (data && fread(data, 1, len, fp) != (size_t)len)
+    {
+        free(data);
+        data = NULL;
+    }
+
+    fclose(fp);
+    *size = data ? (DWORD)len : 0;
+    return data;
+}
+
+int main(int argc, char **argv)
+{
+    DWORD interval = 1000;
+    int arg = 1;
+
+    if (argc > arg + 1 && strcmp(argv[arg], "-interval") == 0)
+    {
+        interval = atoi(argv[arg + 1]);
+        arg += 2;
+    }
+
+    if (argc - arg < 1 || interval == 0)
+    {
+        printf("usage: oggpack [-interval ms] music_dir [out.pak]\n");
+        return 1;
+    }
+
+    const char *music = argv[arg];
+    char out[MAX_PATH];
+
+    if (argc - arg > 1)
+        snprintf(out, sizeof out, "%s", argv[arg + 1]);
+    else
+        snprintf(out, sizeof out, "%s\\music.pak", music);
+
+    static struct track tracks[MAX_TRACKS];
+    DWORD num = 0, position = 0, seeks = 0, i;
+
+    /* same rules as scan_tracks: tracks under 4 seconds are data tracks */
+    for (i = 1; i < MAX_TRACKS; i++)
+    {
+        struct track *t = &tracks[num];
+        char path[MAX_PATH];
+
+        snprintf(path, sizeof path, "%s\\Track%02u.ogg", music, (unsigned)i);
+        memset(t, 0, sizeof *t);
+
+        if (!(t->data = read_file(path, &t->info.size)))
+            continue;
+
+        if (!parse(t, interval))
+        {
+            printf("%s: not a single stream Ogg Vorbis file, skipped\n", path);
+            free(t->data);
+            free(t->seek);
+            continue;
+        }
+
+        if (t->info.length < 4)
+        {
+            free(t->data);
+            free(t->seek);
+            continue;
+        }
+
+        t->info.number = i;
+        t->info.position = position + 2; /* 2 second pre-gap */
+        position += t->info.length;
+        seeks += t->info.seek_count;
+
+        printf("Track %02u: %02u:%02u @ %u seconds, %u Hz, %u channels, %u seek points\n", (unsigned)i,
+            (unsigned)t->info.length / 60, (unsigned)t->info.length % 60, (unsigned)t->info.position,
+            (unsigned)t->info.rate, (unsigned)t->info.channels, (unsigned)t->info.seek_count);
+
+        num++;
+    }
+
+    if (num == 0)
+    {
+        printf("No tracks found in %s\n", music);
+        return 1;
+    }
+
+    struct pak_header hdr;
+    memcpy(hdr.magic, PAK_MAGIC, 4);
+    hdr.version = PAK_VERSION;
+    hdr.num_tracks = num;
+    hdr.seek_interval = interval;
+
+    ULONGLONG offset = sizeof hdr + num * sizeof(struct pak_track);
+    ULONGLONG data = offset + seeks * sizeof(struct pak_seek);
+
+    for (i = 0; i < num; i++)
+    {
+        tracks[i].info.seek_offset = (DWORD)offset;
+        tracks[i].info.offset = (DWORD)data;
+        offset += tracks[i].info.seek_count * sizeof(struct pak_seek);
+        data += tracks[i].info.size;
+    }
+
+    if (data > 0xFFFFFFFF)
+    {
+        printf("The tracks do not fit in a 4 GB pak\n");
+        return 1;
+    }
+
+    FILE *fp = fopen(out, "wb");
+
+    if (!fp)
+    {
+        printf("Could not create %s\n", out);
+        return 1;
+    }
+
+    fwrite(&hdr, sizeof hdr, 1, fp);
+
+    for (i = 0; i < num; i++)
+        fwrite(&tracks[i].info, sizeof tracks[i].info, 1, fp);
+
+    for (i = 0; i < num; i++)
+        fwrite(tracks[i].seek, sizeof(struct pak_seek), tracks[i].info.seek_count, fp);
+
+    for (i = 0; i < num; i++)
+        fwrite(tracks[i].data, 1, tracks[i].info.size, fp);
+
+    if (fclose(fp) != 0)
+    {
+        printf("Could not write %s\n", out);
+        return 1;
+    }
+
+    printf("\nPacked %u tracks, %.1f MB into %s\n", (unsigned)num, data / (1024.0 * 1024.0), out);
+
+    return 0;
+}
@@ -0,0 +1,144 @@
+/* oggrender - renders an MCI command script to a WAV file with the virtual
+   clock, as fast as the tracks decode.
+
+   usage: oggrender [-dll path\to\winmm.dll] music_dir script.txt out.wav
+
+   Every script line is a time in seconds followed by an MCI command string:
+
+       # comment
+       0     open cdaudio
+       0     set cdaudio time format tmsf
+       0.5   play cdaudio from 3 to 5
+       20    pause cdaudio
+       22.25 play cdaudio
+
+   After the last line the render continues until playback stops. */
+
+#include <windows.h>
+#include <stdio.h>
+
+typedef MCIERROR (WINAPI *SENDSTRING)(LPCSTR, LPSTR, UINT, HWND);
+typedef DWORD (WINAPI *VCLOCKRUN)(DWORD);
+typedef BOOL (WINAPI *RENDER)(const char *, const char *);
+
+static double cpu_seconds()
+{
+    FILETIME create, exit, kernel, user;
+    GetProcessTimes(GetCurrentProcess(), &create, &exit, &kernel, &user);
+
+    ULONGLONG k = ((ULONGLONG)kernel.dwHighDateTime << 32) | kernel.dwLowDateTime;
+    ULONGLONG u = ((ULONGLONG)user.dwHighDateTime << 32) | user.dwLowDateTime;
+
+    return (k + u) / 10000000.0;
+}
+
+int main(int argc, char **argv)
+{
+    const char *dll_path = ".\\winmm.dll";
+    int arg = 1;
+
+    if (argc > arg + 1 && strcmp(argv[arg], "-dll") == 0)
+    {
+        dll_path = argv[arg + 1];
+        arg += 2;
+    }
+
+    if (argc - arg < 3)
+    {
+        printf("usage: oggrender [-dll path\\to\\winmm.dll] music_dir script.txt out.wav\n");
+        return 1;
+    }
+
+    const char *music = argv[arg];
+    const char *script = argv[arg + 1];
+    const char *wav = argv[arg + 2];
+
+    FILE *fp = fopen(script, "r");
+    if (!fp)
+    {
+        printf("Could not open %s\n", script);
+        return 1;
+    }
+
+    HMODULE dll = LoadLibrary(dll_path);
+    if (!dll)
+    {
+        printf("Could not load %s\n", dll_path);
+        return 1;
+    }
+
+    SENDSTRING send_string = (SENDSTRING)GetProcAddress(dll, "mciSendStringA");
+    VCLOCKRUN vclock_run = (VCLOCKRUN)GetProcAddress(dll, "ogg_vclock_run");
+    RENDER render = (RENDER)GetProcAddress(dll, "ogg_render");
+
+    if (!send_string || !vclock_run || !render)
+    {
+        printf("%s is not an ogg-winmm build with offline rendering\n", dll_path);
+        return 1;
+    }
+
+    LARGE_INTEGER freq, start, stop;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&start);
+    double cpu_start = cpu_seconds();
+
+    if (!render(music, wav))
+    {
+        printf("Could not create %s\n", wav);
+        return 1;
+    }
+
+    char line[1024];
+    int num = 0, failed = 0;
+
+    while (fgets(line, sizeof line, fp))
+    {
+        double when;
+        int skip;
+        char ret[256];
+
+        num++;
+        line[strcspn(line, "\r\n")] = '\0';
+
+        if (line[0] == '#' || line[0] == '\0')
+            continue;
+
+        if (sscanf(line, "%lf %n", &when, &skip) != 1)
+        {
+            printf("%s:%d: expected a time in seconds\n", script, num);
+            failed++;
+            continue;
+        }
+
+        DWORD now = vclock_run((DWORD)(when * 1000 + 0.5));
+
+        ret[0] = '\0';
+        MCIERROR err = send_string(line + skip, ret, sizeof ret, NULL);
+
+        printf("%10.3f  %-40s", now / 1000.0, line + skip);
+        if (ret[0]) printf(" -> %s", ret);
+        if (err) printf(" (error %u)", err);
+        printf("\n");
+
+        if (err) failed++;
+    }
+
+    fclose(fp);
+
+    DWORD length = vclock_run(INFINITE);
+    render(NULL, NULL);
+
+    QueryPerformanceCounter(&stop);
+    double wall = (double)(stop.QuadPart - start.QuadPart) / freq.QuadPart;
+    double cpu = cpu_seconds() - cpu_start;
+
+    printf("\nRendered %.3f s of audio to %s\n", length / 1000.0, wav);
+    printf("%.3f s wall clock (%.1fx real time), %.3f s CPU", wall, wall > 0 ? length / 1000.0 / wall : 0, cpu);
+    if (cpu > 0)
+        printf(" (%.1f s of audio per CPU second)", length / 1000.0 / cpu);
+    printf("\n");
+
+    FreeLibrary(dll);
+
+    return failed != 0;
+}
@@ -0,0 +1,127 @@
+/* timerbench - compares the cost of timeGetTime in an ogg-winmm build with
+   the one of the system winmm.dll
+
+   usage: timerbench [-calls n] [path\to\winmm.dll]
+
+   Both functions are called n times (10000000 by default) in a tight loop
+   and the cost per call is reported. The values of the wrapper are checked
+   to never go backwards, and how far they are from the system ones is
+   shown (up to a timer period apart when a source is finer than the
+   system one).
+   Set NativeTimer (and TimerPeriod) in the winmm.ini next to the tested
+   DLL, with NativeTimer = 0 the forwarding to the system is measured. */
+
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef DWORD (WINAPI *GETTIME)(void);
+typedef MCIERROR (WINAPI *SENDSTRING)(LPCSTR, LPSTR, UINT, HWND);
+
+static LARGE_INTEGER freq;
+
+static double now_ns()
+{
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return now.QuadPart * 1e9 / freq.QuadPart;
+}
+
+/* ns per call, counts the times the value went backwards */
+static double measure(GETTIME get_time, int calls, int *backwards)
+{
+    DWORD last = get_time(), t;
+    int i;
+
+    *backwards = 0;
+
+    double start = now_ns();
+
+    for (i = 0; i < calls; i++)
+    {
+        t = get_time();
+        if ((LONG)(t - last) < 0)
+            (*backwards)++;
+        last = t;
+    }
+
+    return (now_ns() - start) / calls;
+}
+
+int main(int argc, char **argv)
+{
+    int calls = 10000000, arg = 1, backwards, i;
+    const char *dll_path = "winmm.dll";
+    char system_path[MAX_PATH];
+
+    if (argc > arg + 1 && strcmp(argv[arg], "-calls") == 0)
+    {
+        calls = atoi(argv[arg + 1]);
+        arg += 2;
+    }
+
+    if (argc > arg)
+        dll_path = argv[arg++];
+
+    if (argc > arg || calls < 1)
+    {
+        printf("usage: timerbench [-calls n] [path\\to\\winmm.dll]\n");
+        return 1;
+    }
+
+    GetSystemDirectory(system_path, MAX_PATH);
+    strncat(system_path, "\\winmm.dll", MAX_PATH - strlen(system_path) - 1);
+
+    HMODULE dll = LoadLibrary(dll_path);
+    HMODULE system = LoadLibrary(system_path);
+
+    if (!dll || !system)
+    {
+        printf("Could not load %s\n", dll ? system_path : dll_path);
+        return 1;
+    }
+
+    GETTIME wrapper_time = (GETTIME)GetProcAddress(dll, "timeGetTime");
+    GETTIME system_time = (GETTIME)GetProcAddress(system, "timeGetTime");
+    SENDSTRING send_string = (SENDSTRING)GetProcAddress(dll, "mciSendStringA");
+
+    if (wrapper_time == system_time)
+    {
+        printf("%s is the system winmm.dll\n", dll_path);
+        return 1;
+    }
+
+    /* returns once the wrapper has read its winmm.ini */
+    char ret[64];
+    if (send_string)
+        send_string("sysinfo cdaudio quantity", ret, sizeof ret, NULL);
+
+    QueryPerformanceFrequency(&freq);
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_HIGHEST);
+
+    double system_ns = measure(system_time, calls, &backwards);
+    printf("system  timeGetTime: %6.1f ns per call\n", system_ns);
+
+    double wrapper_ns = measure(wrapper_time, calls, &backwards);
+    printf("wrapper timeGetTime: %6.1f ns per call (%.2fx), went backwards %d times\n",
+        wrapper_ns, system_ns / wrapper_ns, backwards);
+
+    /* sample both clocks for a second */
+    LONG min_diff = 0, max_diff = 0;
+
+    for (i = 0; i < 100; i++)
+    {
+        LONG diff = (LONG)(wrapper_time() - system_time());
+
+        if (i == 0 || diff < min_diff)
+            min_diff = diff;
+        if (i == 0 || diff > max_diff)
+            max_diff = diff;
+        Sleep(10);
+    }
+
+    printf("wrapper - system: %ld to %ld ms\n", min_diff, max_diff);
+
+    return backwards != 0;
+}
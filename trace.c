@@ -0,0 +1,205 @@
+/* MCI trace recorder, see trace.h for the file format. */
+
+#include <windows.h>
+#include <stdio.h>
+#include "trace.h"
+
+int                 trace_enabled   = 0;
+static FILE         *trace_fh       = NULL;
+static LARGE_INTEGER trace_freq;
+static LARGE_INTEGER trace_start;
+static CRITICAL_SECTION trace_cs;
+
+int trace_open(const char *path)
+{
+    trace_fh = fopen(path, "wb");
+
+    if (!trace_fh)
+        return 0;
+
+    struct trace_header hdr = { TRACE_MAGIC, TRACE_VERSION };
+    fwrite(&hdr, sizeof hdr, 1, trace_fh);
+
+    InitializeCriticalSection(&trace_cs);
+    QueryPerformanceFrequency(&trace_freq);
+    QueryPerformanceCounter(&trace_start);
+    trace_enabled = 1;
+
+    return 1;
+}
+
+void trace_close()
+{
+    if (!trace_enabled)
+        return;
+
+    EnterCriticalSection(&trace_cs);
+    trace_enabled = 0;
+    fclose(trace_fh);
+    trace_fh = NULL;
+    LeaveCriticalSection(&trace_cs);
+}
+
+ULONGLONG trace_clock()
+{
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+
+    /* seconds and the rest apart, the product overflows within hours at TSC rates */
+    ULONGLONG ticks = now.QuadPart - trace_start.QuadPart, freq = trace_freq.QuadPart;
+    return ticks / freq * 1000000 + ticks % freq * 1000000 / freq;
+}
+
+/* payload is assembled here before it is written out in one go */
+static char     trace_buf[4096];
+static int      trace_len;
+
+static void trace_put(const void *data, int len)
+{
+    if (trace_len + len > sizeof trace_buf)
+        len = sizeof trace_buf - trace_len;
+
+    memcpy(trace_buf + trace_len, data, len);
+    trace_len += len;
+}
+
+static void trace_put_str(LPCSTR str, UINT max)
+{
+    if (max > 1024)
+        max = 1024;
+
+    WORD len = (str && !IS_INTRESOURCE(str)) ? strnlen(str, max) : 0;
+    trace_put(&len, sizeof len);
+    trace_put(str, len);
+}
+
+static void trace_write(BYTE type, ULONGLONG start)
+{
+    struct trace_record rec;
+    ULONGLONG now = trace_clock();
+
+    rec.type    = type;
+    rec.size    = trace_len;
+    rec.thread  = GetCurrentThreadId();
+    rec.time    = start;
+    rec.elapsed = (DWORD)(now - start);
+
+    fwrite(&rec, sizeof rec, 1, trace_fh);
+    fwrite(trace_buf, trace_len, 1, trace_fh);
+}
+
+/* size of the parameter struct a command message carries */
+static int trace_parms_size(UINT msg)
+{
+    switch (msg)
+    {
+        case MCI_OPEN:          return sizeof(MCI_OPEN_PARMS);
+        case MCI_PLAY:          return sizeof(MCI_PLAY_PARMS);
+        case MCI_SEEK:          return sizeof(MCI_SEEK_PARMS);
+        case MCI_STATUS:        return sizeof(MCI_STATUS_PARMS);
+        case MCI_SET:           return sizeof(MCI_SET_PARMS);
+        case MCI_GETDEVCAPS:    return sizeof(MCI_GETDEVCAPS_PARMS);
+        case MCI_INFO:          return sizeof(MCI_INFO_PARMS);
+        case MCI_SYSINFO:       return sizeof(MCI_SYSINFO_PARMSA);
+        default:                return sizeof(MCI_GENERIC_PARMS);
+    }
+}
+
+void trace_command(ULONGLONG start, MCIDEVICEID device, UINT msg, DWORD_PTR flags, DWORD_PTR parms, MCIERROR result)
+{
+    struct trace_command cmd;
+    DWORD words[16];
+
+    cmd.device      = device;
+    cmd.msg         = msg;
+    cmd.flags       = flags;
+    cmd.result      = result;
+    cmd.has_parms   = parms != 0;
+    cmd.words       = parms ? trace_parms_size(msg) / sizeof(DWORD_PTR) : 0;
+
+    int i;
+    for (i = 0; i < cmd.words; i++)
+        words[i] = ((DWORD_PTR *)parms)[i];
+
+    EnterCriticalSection(&trace_cs);
+
+    if (!trace_enabled)
+    {
+        LeaveCriticalSection(&trace_cs);
+        return;
+    }
+
+    trace_len = 0;
+
+    if (parms && msg == MCI_OPEN)
+    {
+        LPMCI_OPEN_PARMS p = (LPVOID)parms;
+        if (!(flags & MCI_OPEN_TYPE_ID))
+            words[2] = 0;
+        words[3] = 0;
+        words[4] = 0;
+        trace_put(&cmd, sizeof cmd);
+        trace_put(words, cmd.words * sizeof(DWORD));
+        trace_put_str((flags & MCI_OPEN_TYPE) && !(flags & MCI_OPEN_TYPE_ID) ? p->lpstrDeviceType : NULL, MAX_PATH);
+        trace_put_str((flags & MCI_OPEN_ELEMENT) && !(flags & MCI_OPEN_ELEMENT_ID) ? p->lpstrElementName : NULL, MAX_PATH);
+        trace_put_str(flags & MCI_OPEN_ALIAS ? p->lpstrAlias : NULL, MAX_PATH);
+    }
+    else if (parms && (msg == MCI_INFO || msg == MCI_SYSINFO))
+    {
+        LPMCI_INFO_PARMS p = (LPVOID)parms;
+        words[1] = 0;
+        trace_put(&cmd, sizeof cmd);
+        trace_put(words, cmd.words * sizeof(DWORD));
+        trace_put_str(result == 0 ? p->lpstrReturn : NULL, p->dwRetSize);
+    }
+    else
+    {
+        trace_put(&cmd, sizeof cmd);
+        trace_put(words, cmd.words * sizeof(DWORD));
+    }
+
+    trace_write(TRACE_COMMAND, start);
+
+    LeaveCriticalSection(&trace_cs);
+}
+
+void trace_string(ULONGLONG start, LPCSTR cmd, LPCSTR ret, UINT ret_size, MCIERROR result)
+{
+    struct trace_string str = { result, ret_size };
+
+    EnterCriticalSection(&trace_cs);
+
+    if (!trace_enabled)
+    {
+        LeaveCriticalSection(&trace_cs);
+        return;
+    }
+
+    trace_len = 0;
+    trace_put(&str, sizeof str);
+    trace_put_str(cmd, 1024);
+    trace_put_str(ret, ret_size);
+    trace_write(TRACE_STRING, start);
+
+    LeaveCriticalSection(&trace_cs);
+}
+
+void trace_notify(WPARAM status, MCIDEVICEID device)
+{
+    struct trace_notify ntf = { status, device };
+    ULONGLONG now = trace_clock();
+
+    EnterCriticalSection(&trace_cs);
+
+    if (!trace_enabled)
+    {
+        LeaveCriticalSection(&trace_cs);
+        return;
+    }
+
+    trace_len = 0;
+    trace_put(&ntf, sizeof ntf);
+    trace_write(TRACE_NOTIFY, now);
+
+    LeaveCriticalSection(&trace_cs);
+}
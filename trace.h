@@ -0,0 +1,73 @@
+/* MCI trace file format (winmm.trc), written with Trace = 1 in winmm.ini
+   and read back by tools/mcireplay.c.
+
+   The file starts with a trace_header and is followed by records. Every
+   record is a trace_record followed by `size` bytes of payload:
+
+   TRACE_COMMAND: trace_command, `words` DWORDs of the parameter struct as it
+                  was after the call (pointer fields zeroed), then the strings
+                  listed below, each as a WORD length and the bytes.
+                  MCI_OPEN:               device type, element, alias
+                  MCI_INFO / MCI_SYSINFO: returned string
+   TRACE_STRING:  trace_string, command string, returned string.
+   TRACE_NOTIFY:  trace_notify.
+
+   All integers are little endian, times are microseconds since the trace
+   was opened. */
+
+#define TRACE_MAGIC     0x5254574F  /* "OWTR" */
+#define TRACE_VERSION   1
+
+#define TRACE_COMMAND   1
+#define TRACE_STRING    2
+#define TRACE_NOTIFY    3
+
+#pragma pack(push, 1)
+
+struct trace_header
+{
+    DWORD magic;
+    DWORD version;
+};
+
+struct trace_record
+{
+    BYTE type;
+    WORD size;
+    DWORD thread;
+    ULONGLONG time;
+    DWORD elapsed;      /* call duration */
+};
+
+struct trace_command
+{
+    DWORD device;
+    DWORD msg;
+    DWORD flags;
+    DWORD result;
+    DWORD has_parms;
+    DWORD words;
+};
+
+struct trace_string
+{
+    DWORD result;
+    DWORD ret_size;
+};
+
+struct trace_notify
+{
+    DWORD status;
+    DWORD device;
+};
+
+#pragma pack(pop)
+
+int trace_open(const char *path);
+void trace_close();
+ULONGLONG trace_clock();
+void trace_command(ULONGLONG start, MCIDEVICEID device, UINT msg, DWORD_PTR flags, DWORD_PTR parms, MCIERROR result);
+void trace_string(ULONGLONG start, LPCSTR cmd, LPCSTR ret, UINT ret_size, MCIERROR result);
+void trace_notify(WPARAM status, MCIDEVICEID device);
+
+extern int trace_enabled;